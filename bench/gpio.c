@@ -0,0 +1,175 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+/*
+ * Compares the per frame cost of each gpio backend.
+ *
+ * For every backend that initialises, times bare frames of gpio access (the latch and clock writes and level reads
+ * of ReadGamepads without its pulse delays) and then full ReadGamepads frames.
+ * Results are printed one backend per line as key=value pairs.
+ *
+ * Usage: snesdev-gpio-bench [-f frames] [-l latch gpio] [-c clock gpio] [-d data gpio]... [-C gpio chip] [-s sim script]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "GPIO.h"
+#include "gamepad.h"
+#include "scheduler.h"
+#include "timing.h"
+
+#define BENCH_MAX_GAMEPADS 16
+
+static void Bench(GpioBackendType backend, GpioConfig *gpioConfig, GamepadsConfig *config, unsigned int frames);
+
+int main(int argc, char *argv[]) {
+    unsigned int frames = 10000;
+    GpioConfig gpioConfig;
+    memset(&gpioConfig, 0, sizeof(gpioConfig));
+    gpioConfig.GpioChip = "/dev/gpiochip0";
+
+    GamepadBusConfig bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.Id = 1;
+    bus.Type = GAMEPAD_SNES;
+    bus.LatchGpio = 19;
+    bus.ClockGpio = 26;
+
+    GamepadsConfig config;
+    memset(&config, 0, sizeof(config));
+    config.TotalBuses = 1;
+    config.Buses = &bus;
+    config.LatchHigh = 12000;
+    config.LatchLow = 6000;
+    config.ClockLow = 6000;
+    config.ClockHigh = 6000;
+
+    GamepadConfig gamepadConfigs[BENCH_MAX_GAMEPADS];
+    config.Gamepads = gamepadConfigs;
+    uint8_t dataGpios[BENCH_MAX_GAMEPADS];
+    unsigned int totalGamepads = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "f:l:c:d:C:s:")) != -1) {
+        switch (option) {
+            case 'f':
+                frames = (unsigned int) atoi(optarg);
+                break;
+            case 'l':
+                bus.LatchGpio = (uint8_t) atoi(optarg);
+                break;
+            case 'c':
+                bus.ClockGpio = (uint8_t) atoi(optarg);
+                break;
+            case 'd':
+                if (totalGamepads < BENCH_MAX_GAMEPADS) {
+                    dataGpios[totalGamepads++] = (uint8_t) atoi(optarg);
+                }
+                break;
+            case 'C':
+                gpioConfig.GpioChip = optarg;
+                break;
+            case 's':
+                gpioConfig.SimScript = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-f frames] [-l latch] [-c clock] [-d data]... [-C gpio chip] [-s sim script]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    CalibrateTiming();
+
+    if (totalGamepads == 0) {
+        dataGpios[totalGamepads++] = 20;
+        dataGpios[totalGamepads++] = 21;
+    }
+
+    config.Total = totalGamepads;
+    for (unsigned int i = 0; i < totalGamepads; i++) {
+        config.Gamepads[i].Id = i + 1;
+        config.Gamepads[i].DataGpio = dataGpios[i];
+    }
+
+    // Backends are numbered from 1, an unknown one has no name.
+    for (unsigned int backend = 1; *GetGpioBackendTypeString((GpioBackendType) backend) != '\0'; backend++) {
+        Bench((GpioBackendType) backend, &gpioConfig, &config, frames);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void Bench(GpioBackendType backend, GpioConfig *const gpioConfig, GamepadsConfig *const config, unsigned int frames) {
+    gpioConfig->Backend = backend;
+    if (!GpioInit(gpioConfig)) {
+        printf("backend=%s skipped=1\n", GetGpioBackendTypeString(backend));
+        return;
+    }
+
+    OpenGamepadControlPins(config);
+    Gamepad gamepads[config->Total];
+    memset(gamepads, 0, sizeof(gamepads));
+    for (unsigned int i = 0; i < config->Total; i++) {
+        OpenGamepad(&gamepads[i], config, &config->Gamepads[i]);
+    }
+
+    const uint32_t latchMask = config->LatchMask;
+    const uint32_t clockMask = config->ClockMask;
+    volatile uint32_t levels = 0;
+
+    uint64_t start = MonotonicNanos();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        GpioBarrier();
+        GpioWriteMask(latchMask, GPIO_HIGH);
+        GpioWriteMask(latchMask, GPIO_LOW);
+        for (unsigned int clock = 0; clock < config->ClockPulses; clock++) {
+            levels = GpioReadLevels();
+            GpioWriteMask(clockMask, GPIO_LOW);
+            GpioWriteMask(clockMask, GPIO_HIGH);
+        }
+        GpioBarrier();
+    }
+    const uint64_t accessNanos = MonotonicNanos() - start;
+
+    // Full frames include the pulse delays, so run fewer of them.
+    const unsigned int readFrames = frames / 10 > 0 ? frames / 10 : 1;
+    start = MonotonicNanos();
+    for (unsigned int frame = 0; frame < readFrames; frame++) {
+        ReadGamepads(gamepads, config, NULL);
+    }
+    const uint64_t readNanos = MonotonicNanos() - start;
+
+    printf("backend=%s gamepads=%u frames=%u access_ns_per_frame=%llu read_frames=%u read_ns_per_frame=%llu\n",
+           GetGpioBackendTypeString(backend), config->Total, frames, (unsigned long long) (accessNanos / frames),
+           readFrames, (unsigned long long) (readNanos / readFrames));
+    (void) levels;
+
+    GpioClose();
+}
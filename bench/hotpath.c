@@ -0,0 +1,345 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+/*
+ * Times the poll loop's hot path against the simulated gpio backend, with /dev/null standing in for uinput.
+ *
+ * Sweeps the number of gamepads, their type and how often they change, then the buttons under each debounce mode:
+ *   stage=read     ReadGamepads, mostly the simulated backend modelling each shift register on every level read,
+ *                  so it compares builds rather than saying what a frame costs on the bcm2835 or chardev backends
+ *   stage=frame    ProcessGamepadFrame then draining the emitter inline, one whole frame from latch to uinput write
+ *   stage=buttons  ReadButtons
+ * Pulse delays are zero, so this is the cost of the code around the gpio rather than of the protocol.
+ * Results are printed one run per line as key=value pairs. Syscalls counts the read, write and ioctl calls made
+ * through libc, cycles come from perf and are -1 where it isn't available.
+ *
+ * Usage: snesdev-bench [-f frames]
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "GPIOBackend.h"
+#include "button.h"
+#include "emitter.h"
+#include "gamepad.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "timing.h"
+
+#define BENCH_LATCH_GPIO 19
+#define BENCH_CLOCK_GPIO 26
+#define BENCH_BUTTONS 4
+
+static const uint8_t gamepadGpios[] = { 20, 21, 22, 23, 24, 25, 27, 4 };
+static const uint8_t buttonGpios[BENCH_BUTTONS] = { 5, 6, 12, 13 };
+static const unsigned int gamepadCounts[] = { 1, 2, 4, 8 };
+static const unsigned int changeRates[] = { 0, 10, 100, 1000 }; // Per thousand frames, per gamepad or button
+
+// Every button but the directions, so changes never make an impossible frame that gets read again.
+static const uint16_t snesChangeMask = 0x0F0F;
+static const uint16_t nesChangeMask = 0x000F;
+
+static uint64_t syscalls;
+static uint32_t seed = 1;
+
+ssize_t __real_read(int file, void *buffer, size_t count);
+ssize_t __real_write(int file, const void *buffer, size_t count);
+int __real_ioctl(int file, unsigned long request, ...);
+
+static void BenchGamepads(unsigned int total, GamepadType type, unsigned int changeRate, unsigned int frames, int cycleCounter);
+static void BenchButtons(DebounceMode debounce, unsigned int changeRate, unsigned int frames, int cycleCounter);
+static void Change(const uint8_t *gpios, uint16_t *values, unsigned int total, uint16_t mask, unsigned int changeRate);
+static void PrintRun(const char *run, unsigned int changeRate, unsigned int frames, uint64_t nanos, uint64_t calls,
+                     int64_t cycles);
+static int OpenCycleCounter(void);
+static int64_t ReadCycles(int cycleCounter);
+static uint32_t Random(void);
+
+int main(int argc, char *argv[]) {
+    unsigned int frames = 100000;
+
+    int option;
+    while ((option = getopt(argc, argv, "f:")) != -1) {
+        switch (option) {
+            case 'f':
+                frames = (unsigned int) atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-f frames]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    // Calibrated up front as SNESDev does, or the first pulse delay would calibrate inside a timed loop.
+    CalibrateTiming();
+    const int cycleCounter = OpenCycleCounter();
+
+    for (unsigned int type = GAMEPAD_NES; type <= GAMEPAD_SNES; type++) {
+        for (unsigned int count = 0; count < sizeof(gamepadCounts) / sizeof(gamepadCounts[0]); count++) {
+            for (unsigned int rate = 0; rate < sizeof(changeRates) / sizeof(changeRates[0]); rate++) {
+                BenchGamepads(gamepadCounts[count], (GamepadType) type, changeRates[rate], frames, cycleCounter);
+            }
+        }
+    }
+
+    for (unsigned int debounce = DEBOUNCE_NONE; debounce <= DEBOUNCE_INTEGRATOR; debounce++) {
+        for (unsigned int rate = 0; rate < sizeof(changeRates) / sizeof(changeRates[0]); rate++) {
+            BenchButtons((DebounceMode) debounce, changeRates[rate], frames, cycleCounter);
+        }
+    }
+
+    if (cycleCounter >= 0) {
+        close(cycleCounter);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void BenchGamepads(unsigned int total, GamepadType type, unsigned int changeRate, unsigned int frames, int cycleCounter) {
+    GpioConfig gpioConfig;
+    memset(&gpioConfig, 0, sizeof(gpioConfig));
+    gpioConfig.Backend = GPIO_BACKEND_SIM;
+    if (!GpioInit(&gpioConfig)) {
+        return;
+    }
+
+    GamepadBusConfig bus;
+    memset(&bus, 0, sizeof(bus));
+    bus.Id = 1;
+    bus.Type = type;
+    bus.LatchGpio = BENCH_LATCH_GPIO;
+    bus.ClockGpio = BENCH_CLOCK_GPIO;
+
+    GamepadConfig gamepadConfigs[total];
+    GamepadsConfig config;
+    memset(&config, 0, sizeof(config));
+    config.Total = total;
+    config.Gamepads = gamepadConfigs;
+    config.TotalBuses = 1;
+    config.Buses = &bus;
+    config.Retries = 2;
+    config.Oversample = 1;
+    config.DetectPresence = true;
+    config.ConnectFrames = 3;
+    config.DisconnectFrames = 15;
+
+    memset(gamepadConfigs, 0, sizeof(gamepadConfigs));
+    for (unsigned int i = 0; i < total; i++) {
+        memcpy(gamepadConfigs[i].Map, GamepadButtonEvents, sizeof(gamepadConfigs[i].Map));
+        gamepadConfigs[i].Id = i + 1;
+        gamepadConfigs[i].Bus = 0;
+        gamepadConfigs[i].DataGpio = gamepadGpios[i];
+        GpioSimWirePad(gamepadGpios[i], BENCH_LATCH_GPIO, BENCH_CLOCK_GPIO, type == GAMEPAD_NES);
+    }
+    OpenGamepadControlPins(&config);
+
+    // Everything starts plugged in with a device open, so only state changes go through the emitter.
+    Gamepad gamepads[total];
+    InputDevice devices[total];
+    InputDevice keyboard;
+    GamepadEvent pushed[total];
+    uint16_t buttons[total];
+    memset(devices, 0, sizeof(devices));
+    memset(&keyboard, 0, sizeof(keyboard));
+    keyboard.File = -1;
+    memset(pushed, 0, sizeof(pushed));
+    memset(buttons, 0, sizeof(buttons));
+    for (unsigned int i = 0; i < total; i++) {
+        OpenGamepad(&gamepads[i], &config, &gamepadConfigs[i]);
+        gamepads[i].Present = gamepads[i].Connected = true;
+        devices[i].File = open("/dev/null", O_WRONLY);
+        pushed[i].Connected = true;
+    }
+
+    Stats stats;
+    ResetStats(&stats);
+    Emitter emitter;
+    if (!OpenEmitter(&emitter, &config, gamepads, devices, &keyboard, &stats, 0)) {
+        GpioClose();
+        return;
+    }
+
+    const uint16_t changeMask = type == GAMEPAD_NES ? nesChangeMask : snesChangeMask;
+    char run[64];
+
+    seed = 1;
+    uint64_t calls = syscalls;
+    int64_t cycles = ReadCycles(cycleCounter);
+    uint64_t start = MonotonicNanos();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        Change(gamepadGpios, buttons, total, changeMask, changeRate);
+        ReadGamepads(gamepads, &config, NULL);
+    }
+    uint64_t nanos = MonotonicNanos() - start;
+    cycles = cycles < 0 ? -1 : ReadCycles(cycleCounter) - cycles;
+    snprintf(run, sizeof(run), "stage=read gamepads=%u type=%s", total, GetGamepadTypeString(type));
+    PrintRun(run, changeRate, frames, nanos, syscalls - calls, cycles);
+
+    seed = 1;
+    calls = syscalls;
+    cycles = ReadCycles(cycleCounter);
+    start = MonotonicNanos();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        Change(gamepadGpios, buttons, total, changeMask, changeRate);
+        ProcessGamepadFrame(&config, gamepads, NULL, &emitter, pushed, NULL, &stats, frame);
+        DrainEmitter(&emitter);
+    }
+    nanos = MonotonicNanos() - start;
+    cycles = cycles < 0 ? -1 : ReadCycles(cycleCounter) - cycles;
+    snprintf(run, sizeof(run), "stage=frame gamepads=%u type=%s", total, GetGamepadTypeString(type));
+    PrintRun(run, changeRate, frames, nanos, syscalls - calls, cycles);
+
+    CloseEmitter(&emitter);
+    for (unsigned int i = 0; i < total; i++) {
+        close(devices[i].File);
+    }
+    GpioClose();
+}
+
+static void BenchButtons(DebounceMode debounce, unsigned int changeRate, unsigned int frames, int cycleCounter) {
+    GpioConfig gpioConfig;
+    memset(&gpioConfig, 0, sizeof(gpioConfig));
+    gpioConfig.Backend = GPIO_BACKEND_SIM;
+    if (!GpioInit(&gpioConfig)) {
+        return;
+    }
+
+    Button buttons[BENCH_BUTTONS];
+    ButtonFilter filter;
+    uint16_t values[BENCH_BUTTONS];
+    memset(buttons, 0, sizeof(buttons));
+    memset(values, 0, sizeof(values));
+    for (unsigned int i = 0; i < BENCH_BUTTONS; i++) {
+        buttons[i].Gpio = buttonGpios[i];
+        buttons[i].Key = INPUT_KEY_ESC;
+        buttons[i].Debounce = debounce;
+        buttons[i].Samples = 3;
+        OpenButton(&buttons[i]);
+    }
+    OpenButtonFilter(&filter, buttons, BENCH_BUTTONS);
+
+    seed = 1;
+    const uint64_t calls = syscalls;
+    int64_t cycles = ReadCycles(cycleCounter);
+    const uint64_t start = MonotonicNanos();
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        Change(buttonGpios, values, BENCH_BUTTONS, 1, changeRate);
+        ReadButtons(&filter, buttons, BENCH_BUTTONS);
+    }
+    const uint64_t nanos = MonotonicNanos() - start;
+    cycles = cycles < 0 ? -1 : ReadCycles(cycleCounter) - cycles;
+
+    char run[64];
+    snprintf(run, sizeof(run), "stage=buttons buttons=%u debounce=%s", BENCH_BUTTONS, GetDebounceModeString(debounce));
+    PrintRun(run, changeRate, frames, nanos, syscalls - calls, cycles);
+
+    GpioClose();
+}
+
+static void Change(const uint8_t *const gpios, uint16_t *const values, unsigned int total, uint16_t mask,
+                   unsigned int changeRate) {
+    for (unsigned int i = 0; i < total; i++) {
+        if (Random() % 1000 >= changeRate) {
+            continue;
+        }
+
+        // Flip one of the bits in mask.
+        unsigned int flip = Random() % (unsigned int) __builtin_popcount(mask);
+        uint16_t bits = mask;
+        while (flip-- > 0) {
+            bits &= (uint16_t) (bits - 1);
+        }
+        values[i] ^= (uint16_t) (bits & -bits);
+        GpioSimSetValue(gpios[i], values[i]);
+    }
+}
+
+static void PrintRun(const char *const run, unsigned int changeRate, unsigned int frames, uint64_t nanos, uint64_t calls,
+                     int64_t cycles) {
+    printf("%s change_rate=%u.%03u frames=%u ns_per_frame=%llu syscalls_per_frame=%.3f cycles_per_frame=%lld\n",
+           run, changeRate / 1000, changeRate % 1000, frames, (unsigned long long) (nanos / frames),
+           (double) calls / frames, cycles < 0 ? -1LL : (long long) (cycles / frames));
+}
+
+static int OpenCycleCounter(void) {
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+    attributes.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+static int64_t ReadCycles(int cycleCounter) {
+    uint64_t cycles;
+    if (cycleCounter < 0 || __real_read(cycleCounter, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+        return -1;
+    }
+    return (int64_t) cycles;
+}
+
+static uint32_t Random(void) {
+    // xorshift32, seeded the same for every run so they all see the same changes.
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// Linked in with --wrap, so every call made through libc is counted on the way.
+ssize_t __wrap_read(int file, void *buffer, size_t count) {
+    syscalls++;
+    return __real_read(file, buffer, count);
+}
+
+ssize_t __wrap_write(int file, const void *buffer, size_t count) {
+    syscalls++;
+    return __real_write(file, buffer, count);
+}
+
+int __wrap_ioctl(int file, unsigned long request, ...) {
+    va_list arguments;
+    va_start(arguments, request);
+    void *argument = va_arg(arguments, void *);
+    va_end(arguments);
+
+    syscalls++;
+    return __real_ioctl(file, request, argument);
+}
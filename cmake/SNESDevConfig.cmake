@@ -14,13 +14,32 @@ if(NOT DEFINED CONFIG_FILE)
     set(CONFIG_FILE "/etc/gpio/snesdev.cfg")
 endif()
 
-if(NOT DEFINED SNESDEV_MAX_GAMEPADS)
-    set(SNESDEV_MAX_GAMEPADS 2)
-endif()
-
 if(NOT DEFINED SNESDEV_MAX_BUTTONS)
     set(SNESDEV_MAX_BUTTONS 5)
 endif()
 
+if(NOT DEFINED SNESDEV_MAX_CHORDS)
+    set(SNESDEV_MAX_CHORDS 8)
+endif()
+
+if(BCM2835_FOUND)
+    set(SNESDEV_HAVE_BCM2835 1)
+endif()
+
+# The simulated backend is only ever the default when asked for, a build without bcm2835 drives the gpio character device.
+if(NOT DEFINED SNESDEV_GPIO_BACKEND)
+    if(SNESDEV_HAVE_BCM2835)
+        set(SNESDEV_GPIO_BACKEND "bcm2835")
+    else()
+        message(WARNING "bcm2835 library not found, SNESDev defaults to the chardev gpio backend (set BCM2835 to its install prefix to use it)")
+        set(SNESDEV_GPIO_BACKEND "chardev")
+    endif()
+elseif(SNESDEV_GPIO_BACKEND STREQUAL "bcm2835" AND NOT SNESDEV_HAVE_BCM2835)
+    message(FATAL_ERROR "SNESDEV_GPIO_BACKEND is bcm2835 but the bcm2835 library wasn't found")
+elseif(NOT SNESDEV_GPIO_BACKEND MATCHES "^(bcm2835|chardev|sim)$")
+    message(FATAL_ERROR "SNESDEV_GPIO_BACKEND must be bcm2835, chardev or sim")
+endif()
+message(STATUS "Default gpio backend: ${SNESDEV_GPIO_BACKEND}")
+
 configure_file(SNESDevConfig.h.in ${PROJECT_BINARY_DIR}/include/SNESDevConfig.h)
 include_directories(include  ${PROJECT_BINARY_DIR}/include)
\ No newline at end of file
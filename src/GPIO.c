@@ -25,52 +25,97 @@
  * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
  */
  
-#include <bcm2835.h>
-#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "GPIO.h"
+#include "GPIOBackend.h"
+#include "timing.h"
 
-bool GpioOpen(uint8_t pin, GpioDirection direction)
-{
-    switch (direction){
-        case GPIO_OUTPUT:
-            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
-            bcm2835_gpio_write(pin, LOW);
-            return true;
-        case GPIO_INPUT:
-            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
-            return true;
-        case GPIO_INPUT_LOW:
-            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
-            bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_DOWN);
-            return true;
-        case GPIO_INPUT_HIGH:
-            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
-            bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_UP);
-            return true;
+DEFINE_ENUM(GpioBackendType, ENUM_GPIO_BACKEND, unsigned int)
+
+static const GpioBackend *backend;
+
+bool GpioInit(const GpioConfig *const config) {
+    switch (config->Backend) {
+        case GPIO_BACKEND_BCM2835:
+#ifdef SNESDEV_HAVE_BCM2835
+            backend = &GpioBcm2835Backend;
+            break;
+#else
+            fprintf(stderr, "SNESDev was built without the %s gpio backend\n", GetGpioBackendTypeString(config->Backend));
+            return false;
+#endif
+        case GPIO_BACKEND_SIM:
+            backend = &GpioSimBackend;
+            break;
+        case GPIO_BACKEND_CHARDEV:
+            backend = &GpioChardevBackend;
+            break;
+        default:
+            return false;
     }
 
-    return false;
+    return backend->Init(config);
+}
+
+void GpioClose(void) {
+    backend->Close();
+}
+
+bool GpioOpen(uint8_t pin, GpioDirection direction) {
+    return backend->Open(pin, direction);
 }
 
 GpioLevel GpioRead(uint8_t pin) {
-    return (GpioLevel)bcm2835_gpio_lev(pin);
+    backend->Barrier();
+    uint32_t levels = backend->ReadLevels();
+    backend->Barrier();
+    return (levels & GpioPinMask(pin)) != 0 ? GPIO_HIGH : GPIO_LOW;
 }
 
 void GpioWrite(uint8_t pin, GpioLevel val) {
-    bcm2835_gpio_write(pin, val);
+    backend->Barrier();
+    backend->WriteMask(GpioPinMask(pin), val);
+    backend->Barrier();
+}
+
+void GpioPulseHigh(uint8_t pin, uint32_t nanosHigh, uint32_t nanosLow) {
+    GpioWrite(pin, GPIO_HIGH);
+    SpinNanos(nanosHigh);
+    GpioWrite(pin, GPIO_LOW);
+    SpinNanos(nanosLow);
+}
+
+void GpioPulseLow(uint8_t pin, uint32_t nanosLow, uint32_t nanosHigh) {
+    GpioWrite(pin, GPIO_LOW);
+    SpinNanos(nanosLow);
+    GpioWrite(pin, GPIO_HIGH);
+    SpinNanos(nanosHigh);
+}
+
+void GpioBarrier(void) {
+    backend->Barrier();
+}
+
+uint32_t GpioReadLevels(void) {
+    return backend->ReadLevels();
+}
+
+void GpioWriteMask(uint32_t mask, GpioLevel val) {
+    backend->WriteMask(mask, val);
 }
 
-void GpioPulseHigh(uint8_t pin, uint64_t microsHigh, uint64_t microsLow) {
-    bcm2835_gpio_write(pin, HIGH);
-    bcm2835_delayMicroseconds(microsHigh);
-    bcm2835_gpio_write(pin, LOW);
-    bcm2835_delayMicroseconds(microsLow);
+void GpioPulseHighMask(uint32_t mask, uint32_t nanosHigh, uint32_t nanosLow) {
+    backend->WriteMask(mask, GPIO_HIGH);
+    SpinNanos(nanosHigh);
+    backend->WriteMask(mask, GPIO_LOW);
+    SpinNanos(nanosLow);
 }
 
-void GpioPulseLow(uint8_t pin, uint64_t microsLow, uint64_t microsHigh) {
-    bcm2835_gpio_write(pin, LOW);
-    bcm2835_delayMicroseconds(microsLow);
-    bcm2835_gpio_write(pin, HIGH);
-    bcm2835_delayMicroseconds(microsHigh);
+void GpioPulseLowMask(uint32_t mask, uint32_t nanosLow, uint32_t nanosHigh) {
+    backend->WriteMask(mask, GPIO_LOW);
+    SpinNanos(nanosLow);
+    backend->WriteMask(mask, GPIO_HIGH);
+    SpinNanos(nanosHigh);
 }
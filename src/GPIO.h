@@ -28,6 +28,19 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "enum.h"
+#include "gpiochip.h"
+
+// Bulk access only covers the first bank of gpios (0-31), which is every gpio on the header.
+#define GPIO_BANK_SIZE 32
+
+#define ENUM_GPIO_BACKEND(XX) \
+    XX(GPIO_BACKEND_BCM2835, =1, bcm2835) \
+    XX(GPIO_BACKEND_SIM, =2, sim) \
+    XX(GPIO_BACKEND_CHARDEV, =3, chardev)
+
+DECLARE_ENUM(GpioBackendType, ENUM_GPIO_BACKEND)
 
 typedef enum {
     GPIO_OUTPUT = 0,
@@ -41,8 +54,30 @@ typedef enum {
     GPIO_HIGH = 0x1
 } GpioLevel;
 
+typedef struct {
+    GpioBackendType Backend;
+    bool DebugEnabled;
+    const char *SimScript;
+    const char *GpioChip;
+} GpioConfig;
+
+bool GpioInit(const GpioConfig *config);
+void GpioClose(void);
+
 bool GpioOpen(uint8_t pin, GpioDirection direction);
 GpioLevel GpioRead(uint8_t pin);
 void GpioWrite(uint8_t pin, GpioLevel val);
-void GpioPulseHigh(uint8_t pin, uint64_t microsHigh, uint64_t microsLow);
-void GpioPulseLow(uint8_t pin, uint64_t microsLow, uint64_t microsHigh);
+void GpioPulseHigh(uint8_t pin, uint32_t nanosHigh, uint32_t nanosLow);
+void GpioPulseLow(uint8_t pin, uint32_t nanosLow, uint32_t nanosHigh);
+
+// Bulk access to the first bank of gpios. These skip the per-access memory barriers,
+// so bracket a burst of them with GpioBarrier().
+void GpioBarrier(void);
+uint32_t GpioReadLevels(void);
+void GpioWriteMask(uint32_t mask, GpioLevel val);
+void GpioPulseHighMask(uint32_t mask, uint32_t nanosHigh, uint32_t nanosLow);
+void GpioPulseLowMask(uint32_t mask, uint32_t nanosLow, uint32_t nanosHigh);
+
+static inline uint32_t GpioPinMask(uint8_t pin) {
+    return (uint32_t)1 << pin;
+}
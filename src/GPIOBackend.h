@@ -0,0 +1,51 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include "GPIO.h"
+#include "SNESDevConfig.h"
+
+// Implemented by each gpio backend, GPIO.c dispatches to whichever was chosen in GpioInit.
+typedef struct {
+    bool (*Init)(const GpioConfig *config);
+    void (*Close)(void);
+    bool (*Open)(uint8_t pin, GpioDirection direction);
+    void (*Barrier)(void);
+    uint32_t (*ReadLevels)(void);
+    void (*WriteMask)(uint32_t mask, GpioLevel val);
+} GpioBackend;
+
+#ifdef SNESDEV_HAVE_BCM2835
+extern const GpioBackend GpioBcm2835Backend;
+#endif
+extern const GpioBackend GpioSimBackend;
+extern const GpioBackend GpioChardevBackend;
+
+// Drive the simulated backend from code as a script's pad and at lines would, once it's initialised.
+void GpioSimWirePad(uint8_t data, uint8_t latch, uint8_t clock, bool nes);
+void GpioSimSetValue(uint8_t gpio, uint16_t value);
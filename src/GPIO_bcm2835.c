@@ -0,0 +1,84 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+ 
+#include <bcm2835.h>
+#include <stdbool.h>
+
+#include "GPIOBackend.h"
+
+static bool Bcm2835Init(const GpioConfig *const config) {
+    bcm2835_set_debug((uint8_t) config->DebugEnabled);
+    return bcm2835_init() != 0;
+}
+
+static void Bcm2835Close(void) {
+    bcm2835_close();
+}
+
+static bool Bcm2835Open(uint8_t pin, GpioDirection direction)
+{
+    switch (direction){
+        case GPIO_OUTPUT:
+            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_OUTP);
+            bcm2835_gpio_write(pin, LOW);
+            return true;
+        case GPIO_INPUT:
+            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+            return true;
+        case GPIO_INPUT_LOW:
+            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+            bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_DOWN);
+            return true;
+        case GPIO_INPUT_HIGH:
+            bcm2835_gpio_fsel(pin, BCM2835_GPIO_FSEL_INPT);
+            bcm2835_gpio_set_pud(pin, BCM2835_GPIO_PUD_UP);
+            return true;
+    }
+
+    return false;
+}
+
+static void Bcm2835Barrier(void) {
+    __sync_synchronize();
+}
+
+static uint32_t Bcm2835ReadLevels(void) {
+    return bcm2835_peri_read_nb(bcm2835_gpio + BCM2835_GPLEV0 / 4);
+}
+
+static void Bcm2835WriteMask(uint32_t mask, GpioLevel val) {
+    bcm2835_peri_write_nb(bcm2835_gpio + (val == GPIO_HIGH ? BCM2835_GPSET0 : BCM2835_GPCLR0) / 4, mask);
+}
+
+const GpioBackend GpioBcm2835Backend = {
+        Bcm2835Init,
+        Bcm2835Close,
+        Bcm2835Open,
+        Bcm2835Barrier,
+        Bcm2835ReadLevels,
+        Bcm2835WriteMask
+};
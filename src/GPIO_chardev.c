@@ -0,0 +1,240 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+/*
+ * Gpio backend on the gpio character device (e.g. /dev/gpiochip0), which doesn't need root or the bcm2835 registers.
+ *
+ * Every opened gpio is held in a single line request, so each bulk read or write is one ioctl covering all of them.
+ * The request is (re)made on the first access after a gpio is opened. Gpio numbers are used as line offsets,
+ * which matches the numbering on the Raspberry Pi's gpiochip0.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "GPIOBackend.h"
+#include "gpiochip.h"
+
+typedef struct {
+    uint8_t Gpio;
+    GpioDirection Direction;
+} ChardevLine;
+
+static char chip[GPIO_CHIP_LENGTH];
+static ChardevLine lines[GPIO_BANK_SIZE];
+static unsigned int totalLines;
+static int requestFile = -1;
+static bool requestDirty;
+static bool failing; // Last access failed, so it's only reported once until one works again
+static uint32_t outputs;
+
+static bool Request(void);
+static uint64_t ToLineMask(uint32_t mask);
+static void ReportAccess(bool success, const char *what);
+
+static bool ChardevInit(const GpioConfig *const config) {
+    strncpy(chip, config->GpioChip, sizeof(chip) - 1);
+    totalLines = 0;
+    outputs = 0;
+    requestFile = -1;
+    requestDirty = false;
+    failing = false;
+
+    // Lines aren't requested until they're used, so check the chip is there now.
+    if(access(chip, R_OK) < 0) {
+        fprintf(stderr, "Unable to open %s\n", chip);
+        return false;
+    }
+
+    return true;
+}
+
+static void ChardevClose(void) {
+    if(requestFile >= 0) {
+        close(requestFile);
+        requestFile = -1;
+    }
+}
+
+static bool ChardevOpen(uint8_t pin, GpioDirection direction) {
+    if(pin >= GPIO_BANK_SIZE) {
+        return false;
+    }
+
+    ChardevLine *line = NULL;
+    for(unsigned int i = 0; i < totalLines; i++) {
+        if(lines[i].Gpio == pin) {
+            line = lines + i;
+            break;
+        }
+    }
+
+    if(line == NULL) {
+        line = lines + totalLines++;
+        line->Gpio = pin;
+    }
+
+    line->Direction = direction;
+    if(direction == GPIO_OUTPUT) {
+        outputs &= ~GpioPinMask(pin);
+    }
+
+    requestDirty = true;
+    return true;
+}
+
+static void ChardevBarrier(void) {
+}
+
+static uint32_t ChardevReadLevels(void) {
+    // Every input is active low, so a failed read comes back all high: nothing pressed rather than everything.
+    if(requestDirty && !Request()) {
+        ReportAccess(false, "request");
+        return ~(uint32_t) 0;
+    }
+
+    struct gpio_v2_line_values values;
+    values.mask = ToLineMask(~(uint32_t) 0);
+    values.bits = 0;
+    const bool success = ioctl(requestFile, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0;
+    ReportAccess(success, "read");
+    if(!success) {
+        return ~(uint32_t) 0;
+    }
+
+    uint32_t levels = 0;
+    for(unsigned int i = 0; i < totalLines; i++) {
+        if(values.bits & ((uint64_t) 1 << i)) {
+            levels |= GpioPinMask(lines[i].Gpio);
+        }
+    }
+
+    return levels;
+}
+
+static void ChardevWriteMask(uint32_t mask, GpioLevel val) {
+    outputs = val == GPIO_HIGH ? outputs | mask : outputs & ~mask;
+    if(requestDirty && !Request()) {
+        ReportAccess(false, "request");
+        return;
+    }
+
+    struct gpio_v2_line_values values;
+    values.mask = ToLineMask(mask);
+    values.bits = val == GPIO_HIGH ? values.mask : 0;
+    ReportAccess(ioctl(requestFile, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == 0, "write");
+}
+
+// Stays dirty until a request goes through, so a failed one is tried again on the next access.
+static bool Request(void) {
+    ChardevClose();
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.num_lines = totalLines;
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+
+    uint64_t outputLines = 0, pullUpLines = 0, pullDownLines = 0, outputValues = 0;
+    for(unsigned int i = 0; i < totalLines; i++) {
+        const uint64_t bit = (uint64_t) 1 << i;
+        request.offsets[i] = lines[i].Gpio;
+        switch (lines[i].Direction) {
+            case GPIO_OUTPUT:
+                outputLines |= bit;
+                if(outputs & GpioPinMask(lines[i].Gpio)) {
+                    outputValues |= bit;
+                }
+                break;
+            case GPIO_INPUT:
+                break;
+            case GPIO_INPUT_LOW:
+                pullDownLines |= bit;
+                break;
+            case GPIO_INPUT_HIGH:
+                pullUpLines |= bit;
+                break;
+        }
+    }
+
+    struct gpio_v2_line_config *config = &request.config;
+    struct gpio_v2_line_config_attribute *attribute;
+    if(outputLines) {
+        attribute = &config->attrs[config->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+        attribute->attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        attribute->mask = outputLines;
+
+        attribute = &config->attrs[config->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        attribute->attr.values = outputValues;
+        attribute->mask = outputLines;
+    }
+    if(pullUpLines) {
+        attribute = &config->attrs[config->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+        attribute->attr.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+        attribute->mask = pullUpLines;
+    }
+    if(pullDownLines) {
+        attribute = &config->attrs[config->num_attrs++];
+        attribute->attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+        attribute->attr.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN;
+        attribute->mask = pullDownLines;
+    }
+
+    requestFile = RequestGpioLines(chip, &request);
+    requestDirty = requestFile < 0;
+    return requestFile >= 0;
+}
+
+static void ReportAccess(bool success, const char *const what) {
+    if(!success && !failing) {
+        fprintf(stderr, "Unable to %s gpio lines on %s\n", what, chip);
+    }
+    failing = !success;
+}
+
+static uint64_t ToLineMask(uint32_t mask) {
+    uint64_t lineMask = 0;
+    for(unsigned int i = 0; i < totalLines; i++) {
+        if(mask & GpioPinMask(lines[i].Gpio)) {
+            lineMask |= (uint64_t) 1 << i;
+        }
+    }
+    return lineMask;
+}
+
+const GpioBackend GpioChardevBackend = {
+        ChardevInit,
+        ChardevClose,
+        ChardevOpen,
+        ChardevBarrier,
+        ChardevReadLevels,
+        ChardevWriteMask
+};
@@ -0,0 +1,324 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+/*
+ * Simulated gpio backend for running SNESDev without a Raspberry Pi.
+ *
+ * Each gamepad data line is modelled as a 4021 shift register: it parallel loads the scripted buttons
+ * while its latch is high and shifts one bit towards the data line on each rising edge of its clock.
+ * The serial input is grounded, so once every bit has been shifted out the data line reads low.
+ * Gpios that aren't wired to a shift register read their pull, or high when they have none
+ * (i.e. an external pull-up), unless a button on them is scripted as pressed.
+ *
+ * The script is a text file with one command per line, '#' starts a comment:
+ *   pad <data gpio> <latch gpio> <clock gpio> [snes|nes]
+ *   at <milliseconds> <gpio> <value>
+ *   unplug <milliseconds> <data gpio>
+ *   plug <milliseconds> <data gpio>
+ * For a pad the value is a mask of pressed GamepadButton bits, for any other gpio non-zero is pressed.
+ * An unplugged pad leaves its data line to read its pull like any other gpio.
+ * Times are relative to GpioInit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GPIOBackend.h"
+
+#define SIM_SNES_BITS 16
+#define SIM_NES_BITS 8
+#define SIM_LINE_LENGTH 256
+
+typedef struct {
+    bool Wired;
+    bool Unplugged;
+    uint8_t LatchGpio;
+    uint8_t ClockGpio;
+    unsigned int Bits;
+    uint16_t Buttons;
+    uint16_t Register;
+} SimShiftRegister;
+
+typedef enum {
+    SIM_EVENT_VALUE,
+    SIM_EVENT_PLUG,
+    SIM_EVENT_UNPLUG
+} SimEventType;
+
+typedef struct {
+    uint64_t Millis;
+    size_t Order;
+    SimEventType Type;
+    uint8_t Gpio;
+    uint16_t Value;
+} SimEvent;
+
+static SimShiftRegister registers[GPIO_BANK_SIZE];
+static uint32_t inputs;
+static uint32_t outputs;
+static uint32_t pullDowns;
+static uint32_t pressed;
+
+static SimEvent *events;
+static size_t totalEvents;
+static size_t nextEvent;
+static struct timespec start;
+static bool debug;
+
+static bool ParseScript(const char *fileName);
+static void AddEvent(size_t *capacity, SimEventType type, unsigned long long millis, unsigned int gpio, int value);
+static int CompareEvents(const void *a, const void *b);
+static void Advance(void);
+
+static inline void Load(SimShiftRegister *const shiftRegister) {
+    // Buttons are active low.
+    shiftRegister->Register = (uint16_t) (~shiftRegister->Buttons & ((1 << shiftRegister->Bits) - 1));
+}
+
+static bool SimInit(const GpioConfig *const config) {
+    memset(registers, 0, sizeof(registers));
+    inputs = outputs = pullDowns = pressed = 0;
+    totalEvents = nextEvent = 0;
+    debug = config->DebugEnabled;
+
+    if(config->SimScript != NULL && !ParseScript(config->SimScript)) {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    return true;
+}
+
+static void SimClose(void) {
+    free(events);
+    events = NULL;
+    totalEvents = nextEvent = 0;
+}
+
+static bool SimOpen(uint8_t pin, GpioDirection direction) {
+    if(pin >= GPIO_BANK_SIZE) {
+        return false;
+    }
+
+    const uint32_t mask = GpioPinMask(pin);
+    switch (direction) {
+        case GPIO_OUTPUT:
+            inputs &= ~mask;
+            outputs &= ~mask;
+            return true;
+        case GPIO_INPUT:
+        case GPIO_INPUT_HIGH:
+            inputs |= mask;
+            pullDowns &= ~mask;
+            return true;
+        case GPIO_INPUT_LOW:
+            inputs |= mask;
+            pullDowns |= mask;
+            return true;
+    }
+
+    return false;
+}
+
+static void SimBarrier(void) {
+}
+
+static uint32_t SimReadLevels(void) {
+    Advance();
+
+    uint32_t levels = outputs & ~inputs;
+    for(unsigned int pin = 0; pin < GPIO_BANK_SIZE; pin++) {
+        const uint32_t mask = GpioPinMask((uint8_t) pin);
+        if((inputs & mask) == 0) {
+            continue;
+        }
+
+        const SimShiftRegister *shiftRegister = registers + pin;
+        bool high = shiftRegister->Wired && !shiftRegister->Unplugged ? (shiftRegister->Register & 1) != 0
+                                         : (pressed & mask) == 0 && (pullDowns & mask) == 0;
+        if(high) {
+            levels |= mask;
+        }
+    }
+
+    if(debug) {
+        printf("sim: read 0x%08x\n", levels);
+    }
+
+    return levels;
+}
+
+static void SimWriteMask(uint32_t mask, GpioLevel val) {
+    const uint32_t last = outputs;
+    outputs = val == GPIO_HIGH ? outputs | mask : outputs & ~mask;
+    const uint32_t rising = ~last & outputs;
+
+    if(debug) {
+        printf("sim: write 0x%08x %s\n", mask, val == GPIO_HIGH ? "high" : "low");
+    }
+
+    for(unsigned int pin = 0; pin < GPIO_BANK_SIZE; pin++) {
+        SimShiftRegister *shiftRegister = registers + pin;
+        if(!shiftRegister->Wired) {
+            continue;
+        }
+
+        if((outputs & GpioPinMask(shiftRegister->LatchGpio)) != 0) {
+            Load(shiftRegister);
+        } else if((rising & GpioPinMask(shiftRegister->ClockGpio)) != 0) {
+            shiftRegister->Register >>= 1;
+        }
+    }
+}
+
+static void Advance(void) {
+    if(nextEvent >= totalEvents) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t millis = (uint64_t) (now.tv_sec - start.tv_sec) * 1000
+                            + (uint64_t) ((now.tv_nsec - start.tv_nsec) / 1000000);
+
+    for(; nextEvent < totalEvents && events[nextEvent].Millis <= millis; nextEvent++) {
+        const SimEvent *event = events + nextEvent;
+        if(event->Type != SIM_EVENT_VALUE) {
+            registers[event->Gpio].Unplugged = event->Type == SIM_EVENT_UNPLUG;
+        } else {
+            GpioSimSetValue(event->Gpio, event->Value);
+        }
+    }
+}
+
+void GpioSimWirePad(uint8_t data, uint8_t latch, uint8_t clock, bool nes) {
+    SimShiftRegister *shiftRegister = registers + data;
+    shiftRegister->Wired = true;
+    shiftRegister->LatchGpio = latch;
+    shiftRegister->ClockGpio = clock;
+    shiftRegister->Bits = nes ? SIM_NES_BITS : SIM_SNES_BITS;
+    Load(shiftRegister);
+}
+
+void GpioSimSetValue(uint8_t gpio, uint16_t value) {
+    SimShiftRegister *shiftRegister = registers + gpio;
+    if(shiftRegister->Wired) {
+        shiftRegister->Buttons = value;
+        if((outputs & GpioPinMask(shiftRegister->LatchGpio)) != 0) {
+            Load(shiftRegister);
+        }
+    } else if(value != 0) {
+        pressed |= GpioPinMask(gpio);
+    } else {
+        pressed &= ~GpioPinMask(gpio);
+    }
+}
+
+static bool ParseScript(const char *fileName) {
+    FILE *file = fopen(fileName, "r");
+    if(file == NULL) {
+        fprintf(stderr, "Cannot read gpio simulator script %s\n", fileName);
+        return false;
+    }
+
+    size_t capacity = 0;
+    char line[SIM_LINE_LENGTH];
+    unsigned int lineNumber = 0;
+    bool success = true;
+    while(success && fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+
+        char *comment = strchr(line, '#');
+        if(comment != NULL) {
+            *comment = '\0';
+        }
+
+        char command[8], type[8] = "snes";
+        unsigned int data, latch, clock;
+        int value;
+        unsigned long long millis;
+        if(sscanf(line, " %7s", command) != 1) {
+            continue;
+        }
+
+        if(strcmp(command, "pad") == 0 && sscanf(line, " pad %u %u %u %7s", &data, &latch, &clock, type) >= 3
+           && data < GPIO_BANK_SIZE && latch < GPIO_BANK_SIZE && clock < GPIO_BANK_SIZE) {
+            GpioSimWirePad((uint8_t) data, (uint8_t) latch, (uint8_t) clock, strcmp(type, "nes") == 0);
+        } else if(strcmp(command, "at") == 0 && sscanf(line, " at %llu %u %i", &millis, &data, &value) == 3
+                  && data < GPIO_BANK_SIZE) {
+            AddEvent(&capacity, SIM_EVENT_VALUE, millis, data, value);
+        } else if((strcmp(command, "plug") == 0 || strcmp(command, "unplug") == 0)
+                  && sscanf(line, " %*s %llu %u", &millis, &data) == 2 && data < GPIO_BANK_SIZE) {
+            AddEvent(&capacity, strcmp(command, "plug") == 0 ? SIM_EVENT_PLUG : SIM_EVENT_UNPLUG, millis, data, 0);
+        } else {
+            fprintf(stderr, "Bad gpio simulator script %s:%u\n", fileName, lineNumber);
+            success = false;
+        }
+    }
+
+    fclose(file);
+
+    // Stable on script order so events at the same time are applied as written.
+    if(totalEvents > 0) {
+        qsort(events, totalEvents, sizeof(SimEvent), &CompareEvents);
+    }
+    return success;
+}
+
+static void AddEvent(size_t *const capacity, SimEventType type, unsigned long long millis, unsigned int gpio, int value) {
+    if(totalEvents == *capacity) {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        events = realloc(events, *capacity * sizeof(SimEvent));
+    }
+
+    SimEvent *event = events + totalEvents;
+    event->Millis = millis;
+    event->Order = totalEvents;
+    event->Type = type;
+    event->Gpio = (uint8_t) gpio;
+    event->Value = (uint16_t) value;
+    totalEvents++;
+}
+
+static int CompareEvents(const void *a, const void *b) {
+    const SimEvent *x = a, *y = b;
+    if(x->Millis != y->Millis) {
+        return x->Millis < y->Millis ? -1 : 1;
+    }
+    return x->Order < y->Order ? -1 : x->Order > y->Order;
+}
+
+const GpioBackend GpioSimBackend = {
+        SimInit,
+        SimClose,
+        SimOpen,
+        SimBarrier,
+        SimReadLevels,
+        SimWriteMask
+};
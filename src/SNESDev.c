@@ -28,30 +28,59 @@
 #include <linux/uinput.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <bcm2835.h>
 #include <signal.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 #include <sys/syslog.h>
 
 #include "button.h"
 #include "gamepad.h"
+#include "GPIO.h"
 
+#include "capture.h"
 #include "config.h"
 #include "daemon.h"
+#include "emitter.h"
+#include "frameclock.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "timing.h"
 
 
+#define BUTTON_EVENTS_SIZE 16
+
 bool running;
+volatile sig_atomic_t dumpStats;
 
 void InitLog(SNESDevConfig *config);
-void ConfigureGamepads(GamepadsConfig *config, Gamepad *gamepads, InputDevice *gamepadDevices);
-void ConfigureButtons(ButtonsConfig *config, Button *buttons, InputDevice *keyboardDevice);
-void ProcessGamepadFrame(GamepadsConfig *config, Gamepad *gamepads, InputDevice *gamepadDevices, unsigned int verbose);
-void ProcessButtonFrame(Button *buttons, InputDevice *keyboardDevice, unsigned int numberOfEnabledButtons, unsigned int verbose);
+bool ConfigureGamepads(GamepadsConfig *config, Gamepad *gamepads, InputDevice *gamepadDevices);
+void LogGamepadSampling(GamepadsConfig *config);
+bool ConfigureButtons(ButtonsConfig *config, Button *buttons, ButtonFilter *buttonFilter, InputDevice *keyboardDevice,
+                      int *buttonEventsFile);
+void CreateInputDevices(GamepadsConfig *config, const InputCodes *keyboardCodes, Gamepad *gamepads, InputDevice *gamepadDevices,
+                        InputDevice *keyboardDevice, uint64_t started);
+void LogGamepadStats(GamepadsConfig *config, Gamepad *gamepads, bool useSyslog);
+void LogButtonStats(ButtonsConfig *config, Button *buttons, ButtonFilter *buttonFilter, bool useSyslog);
+void ProcessButtonFrame(Button *buttons, ButtonFilter *buttonFilter, InputDevice *keyboardDevice,
+                        unsigned int numberOfEnabledButtons, unsigned int verbose);
+void ProcessButtonEvents(int buttonEventsFile, Button *buttons, InputDevice *keyboardDevice, unsigned int numberOfEnabledButtons,
+                         Stats *stats, unsigned int verbose);
+unsigned int GetButtonFrameDelay(unsigned int gamepadFrequency, unsigned int buttonFrequency);
+void AccountPollTime(Stats *stats, bool idle, uint64_t *since);
+int OpenEvents(Scheduler *scheduler, int buttonEventsFile, int clockFile);
+bool WaitForGamepadFrame(Scheduler *scheduler, FrameClock *clock, uint64_t latchAdvance, int eventsFile, int buttonEventsFile,
+                         Button *buttons, InputDevice *keyboardDevice, unsigned int numberOfEnabledButtons, Stats *stats,
+                         unsigned int verbose);
 void SetupSignals();
 void SignalHandler(int signal);
 
 
 int main(int argc, char *argv[]) {
+    const uint64_t started = MonotonicNanos();
+
     SNESDevConfig config;
     if(!TryGetSNESDevConfig(CONFIG_FILE, argc, argv, &config)) {
         return EXIT_FAILURE;
@@ -59,43 +88,204 @@ int main(int argc, char *argv[]) {
 
     InitLog(&config);
 
-    bcm2835_set_debug((uint8_t) config.DebugEnabled);
-
-    if (!bcm2835_init()) {
+    if (!GpioInit(&config.Gpio)) {
         return EXIT_FAILURE;
     }
 
     TryStartDaemon(&config);
+    StartRealtime(&config.Realtime);
+
+    // Calibrate once we're on the cpu and scheduler we'll poll from.
+    CalibrateTiming();
+    syslog(LOG_INFO, "Timing: { LoopsPerMicrosecond: %llu }", (unsigned long long) TimingLoopsPerMicrosecond());
 
     Gamepad gamepads[config.Gamepads.Total];
     InputDevice gamepadDevices[config.Gamepads.Total];
-    ConfigureGamepads(&config.Gamepads, &gamepads[0], &gamepadDevices[0]);
+    if (!ConfigureGamepads(&config.Gamepads, &gamepads[0], &gamepadDevices[0])) {
+        return EXIT_FAILURE;
+    }
+    LogGamepadSampling(&config.Gamepads);
 
     Button buttons[config.Buttons.Total];
+    ButtonFilter buttonFilter;
     InputDevice keyboardDevice;
-    ConfigureButtons(&config.Buttons, &buttons[0], &keyboardDevice);
+    int buttonEventsFile;
+    if (!ConfigureButtons(&config.Buttons, &buttons[0], &buttonFilter, &keyboardDevice, &buttonEventsFile)) {
+        return EXIT_FAILURE;
+    }
+
+    // Either every frame read is recorded, or recorded frames are played back in place of reading any.
+    Capture capture;
+    const bool capturing = config.CaptureFile != NULL;
+    const bool replaying = config.ReplayFile != NULL;
+    if (replaying && !OpenReplay(&capture, config.ReplayFile, &config.Gamepads, &gamepads[0])) {
+        return EXIT_FAILURE;
+    }
+
+    // Gamepads plugged in from the start are connected before polling, so their devices are created with the keyboard.
+    // A replay connects the ones that were when it was captured.
+    if (config.Gamepads.DetectPresence && !replaying) {
+        ProbeGamepads(&gamepads[0], &config.Gamepads);
+    }
+    if (capturing && !OpenCapture(&capture, config.CaptureFile, &config.Gamepads, &gamepads[0])) {
+        return EXIT_FAILURE;
+    }
+    CreateInputDevices(&config.Gamepads, &config.Keyboard, &gamepads[0], &gamepadDevices[0], &keyboardDevice, started);
 
     SetupSignals();
 
-    bool runButtonFrame = config.Buttons.Total > 0 && config.Buttons.PollFrequency > 0;
-    const unsigned int buttonFrameDelay = runButtonFrame
-                    ? (config.Gamepads.PollFrequency + config.Buttons.PollFrequency - 1) / config.Gamepads.PollFrequency
+    bool runButtonFrame = config.Buttons.Total > 0 && !config.Buttons.Events && config.Buttons.PollFrequency > 0;
+    unsigned int buttonFrameDelay = runButtonFrame
+                    ? GetButtonFrameDelay(config.Gamepads.PollFrequency, config.Buttons.PollFrequency)
                     : 0;
 
+    Scheduler scheduler;
+    if (!OpenScheduler(&scheduler, config.Gamepads.PollFrequency)) {
+        return EXIT_FAILURE;
+    }
+
+    // With a sync source the scheduler is armed one frame at a time, just ahead of the frame clock.
+    FrameClock clock;
+    if (!OpenFrameClock(&clock, &config.Sync, config.Gamepads.PollFrequency)) {
+        return EXIT_FAILURE;
+    }
+    const bool sync = config.Sync.Source != SYNC_SOURCE_NONE;
+    const uint64_t latchAdvance = (uint64_t) config.Sync.LatchAdvance * 1000;
+
+    // Button events and frame ticks are handled as they come in while waiting for the next gamepad frame.
+    int eventsFile = OpenEvents(&scheduler, buttonEventsFile, clock.File);
+
+    Stats stats;
+    ResetStats(&stats);
+
+    // Gamepad states are sent to uinput from another thread, this one only samples.
+    Emitter emitter;
+    GamepadEvent pushed[config.Gamepads.Total];
+    memset(pushed, 0, sizeof(pushed));
+    if (!OpenEmitter(&emitter, &config.Gamepads, gamepads, gamepadDevices, &keyboardDevice, &stats, config.Verbose) || !StartEmitter(&emitter)) {
+        return EXIT_FAILURE;
+    }
+
+    // Chord keys are queued on the keyboard through the frame and go out in the same write as any Buttons keys.
+    Chords chords;
+    OpenChords(&chords, &config.Chords, &keyboardDevice, config.Verbose);
+    Chords *anyChords = config.Chords.Total > 0 ? &chords : NULL;
+
+    // Replayed frames keep their spacing from the first one, which is played straight away.
+    const CaptureRecord *firstRecord = replaying ? PeekCaptureRecord(&capture) : NULL;
+    const uint64_t replayOrigin = firstRecord != NULL ? MonotonicNanos() - firstRecord->Time : 0;
+
+    // Poll at PollFrequency while the gamepads are in use and back off to IdleFrequency when they're not.
+    // Polled buttons ride on the gamepad frames, so idling never drops below their PollFrequency.
+    const unsigned int idleFrequency = runButtonFrame && config.Buttons.PollFrequency > config.Gamepads.IdleFrequency
+                                       ? config.Buttons.PollFrequency : config.Gamepads.IdleFrequency;
+    const bool adaptive = !replaying && config.Gamepads.IdleFrequency > 0 && idleFrequency < config.Gamepads.PollFrequency;
+    const uint64_t idleTimeout = (uint64_t) config.Gamepads.IdleTimeout * NANOS_PER_SECOND;
+    uint64_t lastActive = scheduler.Start;
+    uint64_t pollTimeSince = scheduler.Start;
+    bool idle = false;
+
     unsigned int frameDelayCount = 0;
     while (running) {
-        ProcessGamepadFrame(&config.Gamepads, gamepads, gamepadDevices, config.Verbose);
+        const bool active = replaying
+                ? ReplayGamepadFrame(&config.Gamepads, gamepads, &capture, &emitter, pushed, anyChords, &stats,
+                                     scheduler.Frames)
+                : ProcessGamepadFrame(&config.Gamepads, gamepads, capturing ? &capture : NULL, &emitter, pushed, anyChords,
+                                      &stats, scheduler.Frames);
+
+        if (replaying) {
+            const CaptureRecord *next = PeekCaptureRecord(&capture);
+            if (next == NULL || !SetSchedulerDeadline(&scheduler, replayOrigin + next->Time)) {
+                break;
+            }
+        }
+
+        if (sync) {
+            clock.Sampled = clock.Target;
+            if (!SetSchedulerDeadline(&scheduler, GetFrameClockLatch(&clock, latchAdvance))) {
+                break;
+            }
+        }
+
+        if (adaptive) {
+            const uint64_t now = MonotonicNanos();
+            if (active) {
+                lastActive = now;
+            }
+
+            const bool shouldIdle = !active && now - lastActive >= idleTimeout;
+            if (shouldIdle != idle) {
+                AccountPollTime(&stats, idle, &pollTimeSince);
+                idle = shouldIdle;
+
+                const unsigned int frequency = idle ? idleFrequency : config.Gamepads.PollFrequency;
+                if (!SetSchedulerFrequency(&scheduler, frequency)) {
+                    break;
+                }
+
+                if (runButtonFrame) {
+                    buttonFrameDelay = GetButtonFrameDelay(frequency, config.Buttons.PollFrequency);
+                    frameDelayCount = 0;
+                }
+
+                if (config.Verbose) {
+                    printf("Polling gamepads at %uHz\n", frequency);
+                }
+            }
+        }
 
         if(runButtonFrame) {
             if (frameDelayCount == 0) {
-                ProcessButtonFrame(buttons, &keyboardDevice, config.Buttons.Total, config.Verbose);
+                ProcessButtonFrame(buttons, &buttonFilter, &keyboardDevice, config.Buttons.Total, config.Verbose);
             }
 
             frameDelayCount++;
             frameDelayCount %= buttonFrameDelay;
         }
 
-        bcm2835_delay(config.Gamepads.PollFrequency);
+        // Unless the button frame already sent them.
+        if (anyChords != NULL) {
+            FlushInputDevice(&keyboardDevice);
+        }
+
+        if (dumpStats) {
+            dumpStats = false;
+            stats.Frames = scheduler.Frames;
+            stats.Missed = scheduler.Missed;
+            AccountPollTime(&stats, idle, &pollTimeSince);
+            LogStats(&stats, config.RunAsDaemon);
+            LogGamepadStats(&config.Gamepads, gamepads, config.RunAsDaemon);
+            LogButtonStats(&config.Buttons, buttons, &buttonFilter, config.RunAsDaemon);
+        }
+
+        if (!WaitForGamepadFrame(&scheduler, &clock, latchAdvance, eventsFile, buttonEventsFile, buttons, &keyboardDevice,
+                                 config.Buttons.Total, &stats, config.Verbose)) {
+            continue;
+        }
+
+        RecordStat(&stats, STAT_LATENESS, MonotonicNanos() - scheduler.Deadline);
+    }
+
+    StopEmitter(&emitter);
+    CloseEmitter(&emitter);
+    if (capturing || replaying) {
+        CloseCapture(&capture);
+    }
+
+    stats.Frames = scheduler.Frames;
+    stats.Missed = scheduler.Missed;
+    AccountPollTime(&stats, idle, &pollTimeSince);
+    LogStats(&stats, true);
+    LogGamepadStats(&config.Gamepads, gamepads, true);
+    LogButtonStats(&config.Buttons, buttons, &buttonFilter, true);
+    CloseScheduler(&scheduler);
+    CloseFrameClock(&clock);
+
+    if (eventsFile >= 0) {
+        close(eventsFile);
+    }
+    if (buttonEventsFile >= 0) {
+        close(buttonEventsFile);
     }
 
     CloseInputDevice(&keyboardDevice);
@@ -104,7 +294,8 @@ int main(int argc, char *argv[]) {
     }
 
     closelog();
-    bcm2835_close();
+    GpioClose();
+    FreeSNESDevConfig(&config);
 
     TryStopDaemon(&config);
     return 0;
@@ -114,47 +305,93 @@ void InitLog(SNESDevConfig *const config) {
     // Open the log file
     openlog(LOG_IDENTITY, LOG_PID, config->RunAsDaemon ? LOG_DAEMON : LOG_USER);
 
+    syslog(LOG_INFO, "Gpio: { Backend: %s }", GetGpioBackendTypeString(config->Gpio.Backend));
+    if(config->Gpio.Backend == GPIO_BACKEND_SIM && config->ReplayFile == NULL) {
+        syslog(LOG_WARNING, "Gpio: simulated backend, no gamepads or buttons are read from the hardware");
+    }
+
     for(unsigned int i = 0; i < config->Gamepads.Total; i++) {
         GamepadConfig *gamepad = config->Gamepads.Gamepads + i;
-
-        syslog(LOG_INFO, "Gamepad%u: { Type: %s, PollFrequency: %u, Gpio: { Data: %u, Clock: %u, Latch: %u } }",
-               gamepad->Id, GetGamepadTypeString(config->Gamepads.Type), config->Gamepads.PollFrequency,
-               gamepad->DataGpio, config->Gamepads.ClockGpio, config->Gamepads.LatchGpio);
+        GamepadBusConfig *bus = config->Gamepads.Buses + gamepad->Bus;
+
+        syslog(LOG_INFO, "Gamepad%u: { Bus: %u, Type: %s, PollFrequency: %u, IdleFrequency: %u, IdleTimeout: %u, Gpio: { Data: %u, Clock: %u, Latch: %u }, "
+                         "Pulses: { LatchHigh: %u, LatchLow: %u, ClockLow: %u, ClockHigh: %u }, "
+                         "Presence: { Detect: %s, ConnectFrames: %u, DisconnectFrames: %u } }",
+               gamepad->Id, bus->Id, GetGamepadTypeString(bus->Type), config->Gamepads.PollFrequency,
+               config->Gamepads.IdleFrequency, config->Gamepads.IdleTimeout,
+               gamepad->DataGpio, bus->ClockGpio, bus->LatchGpio,
+               config->Gamepads.LatchHigh, config->Gamepads.LatchLow, config->Gamepads.ClockLow, config->Gamepads.ClockHigh,
+               config->Gamepads.DetectPresence ? "true" : "false", config->Gamepads.ConnectFrames,
+               config->Gamepads.DisconnectFrames);
     }
 
     for(unsigned int i = 0; i < config->Buttons.Total; i++) {
         ButtonConfig *button = config->Buttons.Buttons + i;
 
-        syslog(LOG_INFO, "Button%u: { Key: %s, PollFrequency: %u, Gpio: { Data: %u } }",
-               button->Id, GetInputKeyString(button->Key), config->Buttons.PollFrequency, button->DataGpio);
+        syslog(LOG_INFO, "Button%u: { Key: %s, PollFrequency: %u, Debounce: %s, Samples: %u, Gpio: { Data: %u } }",
+               button->Id, GetInputKeyString(button->Key), config->Buttons.PollFrequency,
+               GetDebounceModeString(button->Debounce), button->Samples, button->DataGpio);
+    }
+
+    if(config->Buttons.Events) {
+        syslog(LOG_INFO, "Buttons: { Events: true, GpioChip: %s }", config->Buttons.GpioChip);
+    }
+
+    syslog(LOG_INFO, "Realtime: { Priority: %u, LockMemory: %s, Cpu: %d }",
+           config->Realtime.Priority, config->Realtime.LockMemory ? "true" : "false", config->Realtime.Cpu);
+
+    if(config->CaptureFile != NULL) {
+        syslog(LOG_INFO, "Capture: { File: %s }", config->CaptureFile);
+    }
+
+    if(config->ReplayFile != NULL) {
+        syslog(LOG_INFO, "Replay: { File: %s }", config->ReplayFile);
+    }
+
+    if(config->Sync.Source != SYNC_SOURCE_NONE) {
+        syslog(LOG_INFO, "Sync: { Source: %s, Socket: %s, SocketGroup: %s, LatchAdvance: %u }",
+               GetSyncSourceString(config->Sync.Source), config->Sync.Socket, config->Sync.SocketGroup,
+               config->Sync.LatchAdvance);
     }
 }
 
-void ConfigureGamepads(GamepadsConfig *const config, Gamepad *const gamepads, InputDevice *const gamepadDevices) {
+bool ConfigureGamepads(GamepadsConfig *const config, Gamepad *const gamepads, InputDevice *const gamepadDevices) {
+    if(!OpenGamepadControlPins(config)) {
+        fprintf(stderr, "Unable to open the gamepad clock and latch gpios\n");
+        return false;
+    }
+
     for(unsigned int i = 0; i < config->Total; i++) {
         GamepadConfig *gamepadConfig = config->Gamepads + i;
 
-        // Open uinput gamepad device.
-        InputDevice *gamepadDevice = &gamepadDevices[i];
-        char buffer[strlen(GAMEPAD_DEVICE_NAME) + 3];
-        sprintf(buffer, "%s %u", GAMEPAD_DEVICE_NAME, gamepadConfig->Id);
-        strcpy(&gamepadDevice->Name[0], buffer);
-
-        OpenInputDevice(INPUT_GAMEPAD, gamepadDevice);
-
         // Open gamepad GPIO interface.
         Gamepad *gamepad = &gamepads[i];
-        memset(gamepad, 0, sizeof(Gamepad));
-        gamepad->DataGpio = gamepadConfig->DataGpio;
-        OpenGamepad(gamepad);
+        if(!OpenGamepad(gamepad, config, gamepadConfig)) {
+            fprintf(stderr, "Unable to open gpio %u of gamepad %u\n", gamepadConfig->DataGpio, gamepadConfig->Id);
+            return false;
+        }
+
+        // The emitter opens the uinput gamepad device once the gamepad is seen plugged in.
+        InputDevice *gamepadDevice = &gamepadDevices[i];
+        memset(gamepadDevice, 0, sizeof(InputDevice));
+        gamepadDevice->File = -1;
+        snprintf(gamepadDevice->Name, sizeof(gamepadDevice->Name), "%s %u", GAMEPAD_DEVICE_NAME, gamepadConfig->Id);
     }
 
-    OpenGamepadControlPins(config);
+    return true;
 }
 
-void ConfigureButtons(ButtonsConfig *const config, Button *const buttons, InputDevice *const keyboardDevice) {
+bool ConfigureButtons(ButtonsConfig *const config, Button *const buttons, ButtonFilter *const buttonFilter,
+                      InputDevice *const keyboardDevice, int *const buttonEventsFile) {
+    // Created along with the gamepads, see CreateInputDevices.
+    memset(keyboardDevice, 0, sizeof(InputDevice));
+    keyboardDevice->File = -1;
+    strcpy(keyboardDevice->Name, KEYBOARD_DEVICE_NAME);
+
+    *buttonEventsFile = -1;
+    memset(buttonFilter, 0, sizeof(ButtonFilter));
     if(config->Total == 0) {
-        return;
+        return true;
     }
 
     for(unsigned int i = 0; i < config->Total; i++) {
@@ -165,76 +402,232 @@ void ConfigureButtons(ButtonsConfig *const config, Button *const buttons, InputD
         memset(button, 0, sizeof(Button));
         button->Gpio = buttonConfig->DataGpio;
         button->Key = buttonConfig->Key;
-        OpenButton(button);
+        button->Debounce = buttonConfig->Debounce;
+        button->Samples = buttonConfig->Samples;
+        if(!config->Events && !OpenButton(button)) {
+            fprintf(stderr, "Unable to open gpio %u of button %u\n", buttonConfig->DataGpio, buttonConfig->Id);
+            return false;
+        }
     }
 
-    strcpy(keyboardDevice->Name, KEYBOARD_DEVICE_NAME);
-    OpenInputDevice(INPUT_KEYBOARD, keyboardDevice);
-}
+    if(config->Events) {
+        *buttonEventsFile = OpenButtonEvents(config->GpioChip, buttons, config->Total);
+        return *buttonEventsFile >= 0;
+    }
 
-void ProcessGamepadFrame(GamepadsConfig *const config, Gamepad *const gamepads, InputDevice *const gamepadDevices, unsigned int verbose) {
-    // Read states of the buttons.
-    ReadGamepads(&gamepads[0], config);
+    OpenButtonFilter(buttonFilter, buttons, config->Total);
 
-    for(unsigned int i = 0; i < config->Total; i++) {
-        Gamepad *gamepad = gamepads + i;
+    return true;
+}
 
-        bool stateUpdated = CheckGamepadState(gamepad);
+void CreateInputDevices(GamepadsConfig *const config, const InputCodes *const keyboardCodes, Gamepad *const gamepads,
+                        InputDevice *const gamepadDevices, InputDevice *const keyboardDevice, uint64_t started) {
+    InputDevice *devices[config->Total + 1];
+    const InputCodes *codes[config->Total + 1];
+    unsigned int total = 0;
 
-        if(verbose > 1 && (stateUpdated || gamepad->State > 0)) {
-            printf("[%u] State 0x%4x%s", i + 1, gamepad->State, stateUpdated ? ", " : "\n");
-        }
+    // Gamepads can be mapped to keys too, so the keyboard is there whenever anything sends on it.
+    if(HasInputCodes(keyboardCodes)) {
+        devices[total] = keyboardDevice;
+        codes[total++] = keyboardCodes;
+    }
 
-        if(!stateUpdated) {
+    // The emitter takes these as already open, and creates the rest as they're plugged in.
+    for(unsigned int i = 0; i < config->Total; i++) {
+        GamepadConfig *gamepadConfig = config->Gamepads + i;
+        if(!gamepads[i].Connected) {
             continue;
         }
 
-        if(verbose > 0) {
-            if(verbose == 1) {
-                printf("[%u] ", i + 1);
-            }
-            printf("A: %d, B: %d, X: %d, Y: %d, L: %d, R: %d, Select: %d, Start: %d, XAxis: %u, YAxis: %u\n",
-                   gamepad->A, gamepad->B, gamepad->X, gamepad->Y, gamepad->L, gamepad->R, gamepad->Select, gamepad->Start,
-                   gamepad->XAxis, gamepad->YAxis);
+        syslog(LOG_INFO, "Gamepad%u connected", gamepadConfig->Id);
+        if(HasInputCodes(&gamepadConfig->Codes)) {
+            devices[total] = &gamepadDevices[i];
+            codes[total++] = &gamepadConfig->Codes;
         }
+    }
 
-        InputDevice *gamepadDevice = &gamepadDevices[i];
-        WriteKey(gamepadDevice, BTN_A, gamepad->A);
-        WriteKey(gamepadDevice, BTN_B, gamepad->B);
-        WriteKey(gamepadDevice, BTN_X, gamepad->X);
-        WriteKey(gamepadDevice, BTN_Y, gamepad->Y);
-        WriteKey(gamepadDevice, BTN_TL, gamepad->L);
-        WriteKey(gamepadDevice, BTN_TR, gamepad->R);
-        WriteKey(gamepadDevice, BTN_SELECT, gamepad->Select);
-        WriteKey(gamepadDevice, BTN_START, gamepad->Start);
-        WriteAxis(gamepadDevice, ABS_X, gamepad->XAxis);
-        WriteAxis(gamepadDevice, ABS_Y, gamepad->YAxis);
-        WriteSync(gamepadDevice);
+    const uint64_t creating = MonotonicNanos();
+    const unsigned int created = OpenInputDevices(devices, codes, total);
+    const uint64_t ready = MonotonicNanos();
+    syslog(LOG_INFO, "Devices: { Created: %u, Failed: %u, CreateMicros: %llu, ReadyMicros: %llu }", created, total - created,
+           (unsigned long long) (ready - creating) / 1000, (unsigned long long) (ready - started) / 1000);
+}
+
+void LogGamepadSampling(GamepadsConfig *const config) {
+    // Time a burst of level reads, oversampling costs the extra ones on every clock of every frame.
+    const unsigned int reads = 1000;
+    uint64_t start = MonotonicNanos();
+    for (unsigned int i = 0; i < reads; i++) {
+        GpioReadLevels();
+    }
+    uint64_t readNanos = (MonotonicNanos() - start) / reads;
+    uint64_t frameNanos = readNanos * (config->Oversample - 1) * config->ClockPulses;
+
+    syslog(LOG_INFO, "Sampling: { Oversample: %u, ReadNanos: %llu, FrameCostNanos: %llu }", config->Oversample,
+           (unsigned long long) readNanos, (unsigned long long) frameNanos);
+}
+
+void LogGamepadStats(GamepadsConfig *const config, Gamepad *const gamepads, bool useSyslog) {
+    char line[128];
+    for(unsigned int i = 0; i < config->Total; i++) {
+        snprintf(line, sizeof(line), "Gamepad%u: { Connected: %s, Rereads: %llu, Errors: %llu }", config->Gamepads[i].Id,
+                 gamepads[i].Connected ? "true" : "false", (unsigned long long) gamepads[i].Rereads,
+                 (unsigned long long) gamepads[i].Errors);
+        LogStatsLine(useSyslog, line);
     }
 }
 
-void ProcessButtonFrame(Button *const buttons, InputDevice *const keyboardDevice, unsigned int numberOfEnabledButtons, unsigned int verbose) {
+void LogButtonStats(ButtonsConfig *const config, Button *const buttons, ButtonFilter *const buttonFilter, bool useSyslog) {
+    // Edge events aren't debounced here, so there's nothing to count.
+    if(config->Events) {
+        return;
+    }
+
+    char line[128];
+    for(unsigned int i = 0; i < config->Total; i++) {
+        snprintf(line, sizeof(line), "Button%u: { Debounce: %s, Bounces: %llu }", config->Buttons[i].Id,
+                 GetDebounceModeString(buttons[i].Debounce), (unsigned long long) buttons[i].Bounces);
+        LogStatsLine(useSyslog, line);
+    }
+
+    if(config->Total > 0) {
+        snprintf(line, sizeof(line), "Buttons: { Bounces: %llu }", (unsigned long long) buttonFilter->Bounces);
+        LogStatsLine(useSyslog, line);
+    }
+}
+
+void ProcessButtonFrame(Button *const buttons, ButtonFilter *const buttonFilter, InputDevice *const keyboardDevice,
+                        unsigned int numberOfEnabledButtons, unsigned int verbose) {
+    ReadButtons(buttonFilter, buttons, numberOfEnabledButtons);
+
     for(unsigned int i = 0; i < numberOfEnabledButtons; i++) {
         Button *button = buttons + i;
 
-        ReadButton(button);
-
         switch (button->State) {
             case BUTTON_STATE_IDLE:
                 break;
             case BUTTON_STATE_PRESSED:
-                WriteKey(keyboardDevice, button->Key, true);
-                WriteSync(keyboardDevice);
+                QueueKey(keyboardDevice, button->Key, true);
                 if(verbose) {
                     printf("Button pressed on Gpio: %u, triggerred key: %s\n", button->Gpio, GetInputKeyString(button->Key));
                 }
                 break;
             case BUTTON_STATE_RELEASED:
-                WriteKey(keyboardDevice, button->Key, false);
-                WriteSync(keyboardDevice);
+                QueueKey(keyboardDevice, button->Key, false);
                 break;
         }
     }
+
+    FlushInputDevice(keyboardDevice);
+}
+
+void ProcessButtonEvents(int buttonEventsFile, Button *const buttons, InputDevice *const keyboardDevice,
+                         unsigned int numberOfEnabledButtons, Stats *const stats, unsigned int verbose) {
+    ButtonEvent events[BUTTON_EVENTS_SIZE];
+    unsigned int totalEvents = ReadButtonEvents(buttonEventsFile, buttons, numberOfEnabledButtons, events, BUTTON_EVENTS_SIZE);
+
+    for(unsigned int i = 0; i < totalEvents; i++) {
+        ButtonEvent *event = events + i;
+        QueueKey(keyboardDevice, event->Button->Key, event->Pressed);
+        if(verbose && event->Pressed) {
+            printf("Button pressed on Gpio: %u, triggerred key: %s\n", event->Button->Gpio, GetInputKeyString(event->Button->Key));
+        }
+    }
+
+    FlushInputDevice(keyboardDevice);
+
+    // Kernel timestamps are from the monotonic clock, so this is edge to sync.
+    const uint64_t emitted = MonotonicNanos();
+    for(unsigned int i = 0; i < totalEvents; i++) {
+        RecordStat(stats, STAT_BUTTON_LATENCY, emitted - events[i].Timestamp);
+    }
+}
+
+unsigned int GetButtonFrameDelay(unsigned int gamepadFrequency, unsigned int buttonFrequency) {
+    // Button frames run on every n-th gamepad frame, as often as asked for or less, never more.
+    return (gamepadFrequency + buttonFrequency - 1) / buttonFrequency;
+}
+
+void AccountPollTime(Stats *const stats, bool idle, uint64_t *const since) {
+    const uint64_t now = MonotonicNanos();
+    if (idle) {
+        stats->IdleNanos += now - *since;
+    } else {
+        stats->ActiveNanos += now - *since;
+    }
+    *since = now;
+}
+
+int OpenEvents(Scheduler *const scheduler, int buttonEventsFile, int clockFile) {
+    if(buttonEventsFile < 0 && clockFile < 0) {
+        return -1;
+    }
+
+    int eventsFile = epoll_create1(EPOLL_CLOEXEC);
+    if(eventsFile < 0) {
+        return -1;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = scheduler->File;
+    epoll_ctl(eventsFile, EPOLL_CTL_ADD, scheduler->File, &event);
+    if(buttonEventsFile >= 0) {
+        event.data.fd = buttonEventsFile;
+        epoll_ctl(eventsFile, EPOLL_CTL_ADD, buttonEventsFile, &event);
+    }
+    if(clockFile >= 0) {
+        event.data.fd = clockFile;
+        epoll_ctl(eventsFile, EPOLL_CTL_ADD, clockFile, &event);
+    }
+
+    return eventsFile;
+}
+
+bool WaitForGamepadFrame(Scheduler *const scheduler, FrameClock *const clock, uint64_t latchAdvance, int eventsFile,
+                         int buttonEventsFile, Button *const buttons, InputDevice *const keyboardDevice,
+                         unsigned int numberOfEnabledButtons, Stats *const stats, unsigned int verbose) {
+    if(eventsFile < 0) {
+        return WaitScheduler(scheduler);
+    }
+
+    struct epoll_event events[3];
+    while(running) {
+        int totalEvents = epoll_wait(eventsFile, events, 3, -1);
+        if(totalEvents < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        bool frameDue = false;
+        bool ticked = false;
+        for(int i = 0; i < totalEvents; i++) {
+            if(events[i].data.fd == buttonEventsFile) {
+                ProcessButtonEvents(buttonEventsFile, buttons, keyboardDevice, numberOfEnabledButtons, stats, verbose);
+            } else if(events[i].data.fd == clock->File) {
+                ticked = ReadFrameClock(clock);
+            } else {
+                frameDue = true;
+            }
+        }
+
+        if(ticked) {
+            RecordStat(stats, STAT_SYNC_ERROR, (uint64_t) (clock->Error < 0 ? -clock->Error : clock->Error));
+        }
+
+        if(frameDue) {
+            return WaitScheduler(scheduler);
+        }
+
+        // Re-arming drops a pending expiry, so only move the latch when the frame isn't already due.
+        if(ticked && !SetSchedulerDeadline(scheduler, GetFrameClockLatch(clock, latchAdvance))) {
+            return false;
+        }
+    }
+
+    return false;
 }
 
 void SetupSignals() {
@@ -248,8 +641,16 @@ void SetupSignals() {
     signal(SIGHUP, SIG_IGN);
     signal(SIGTERM, SignalHandler);
     signal(SIGINT, SignalHandler);
+    signal(SIGUSR1, SignalHandler);
 }
 
 void SignalHandler(int signal) {
-    running = false;
+    switch (signal) {
+        case SIGUSR1:
+            dumpStats = true;
+            break;
+        default:
+            running = false;
+            break;
+    }
 }
@@ -25,33 +25,194 @@
  * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
  */
  
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "button.h"
 #include "GPIO.h"
 
+DEFINE_ENUM(DebounceMode, ENUM_DEBOUNCE_MODE, unsigned int)
+
+static uint32_t FilterConsecutive(const ButtonFilter *filter, uint32_t was);
+static uint32_t FilterIntegrated(ButtonFilter *filter, uint32_t pressed, uint32_t was);
+static uint32_t GetCountersAt(const uint32_t *counter, const uint32_t *limit);
+
 bool OpenButton(Button *const button) {
     button->State = BUTTON_STATE_IDLE;
+    button->Bounces = 0;
     return GpioOpen(button->Gpio, GPIO_INPUT_HIGH);
 }
 
-void ReadButton(Button *const button) {
-    bool buttonPressed = GpioRead(button->Gpio) == GPIO_LOW;
-    switch (button->State) {
-        case BUTTON_STATE_IDLE:
-            if (buttonPressed) {
-                button->State = BUTTON_STATE_PRESSED;
-            }
-            break;
-        case BUTTON_STATE_PRESSED:
-            if (!buttonPressed) {
-                button->State = BUTTON_STATE_RELEASED;
-            }
-            break;
-        case BUTTON_STATE_RELEASED:
-            if (buttonPressed) {
-                button->State = BUTTON_STATE_PRESSED;
-            } else {
-                button->State = BUTTON_STATE_IDLE;
+void OpenButtonFilter(ButtonFilter *const filter, const Button *const buttons, unsigned int numberOfButtons) {
+    memset(filter, 0, sizeof(ButtonFilter));
+    for (unsigned int i = 0; i < numberOfButtons; i++) {
+        const Button *button = buttons + i;
+        const uint32_t mask = GpioPinMask(button->Gpio);
+        filter->Gpios |= mask;
+        filter->Buttons[button->Gpio] = (uint8_t) i;
+
+        switch (button->Debounce) {
+            case DEBOUNCE_CONSECUTIVE:
+                filter->Consecutive[button->Samples] |= mask;
+                if (button->Samples > filter->MaxSamples) {
+                    filter->MaxSamples = button->Samples;
+                }
+                break;
+            case DEBOUNCE_INTEGRATOR:
+                filter->Integrated |= mask;
+                for (unsigned int bit = 0; bit < DEBOUNCE_COUNTER_BITS; bit++) {
+                    filter->Limit[bit] |= (button->Samples & (1u << bit)) ? mask : 0;
+                }
+                break;
+            default:
+                filter->Unfiltered |= mask;
+                break;
+        }
+    }
+}
+
+void ReadButtons(ButtonFilter *const filter, Button *const buttons, unsigned int numberOfButtons) {
+    // Every button comes from the one read.
+    GpioBarrier();
+    const uint32_t levels = GpioReadLevels();
+    GpioBarrier();
+
+    const uint32_t pressed = ~levels & filter->Gpios;
+    const uint32_t previous = filter->Reads[(filter->Next - 1) & (DEBOUNCE_MAX_SAMPLES - 1)];
+    filter->Reads[filter->Next & (DEBOUNCE_MAX_SAMPLES - 1)] = pressed;
+    filter->Next++;
+
+    const uint32_t was = filter->Pressed;
+    filter->Pressed = (pressed & filter->Unfiltered) | FilterConsecutive(filter, was) | FilterIntegrated(filter, pressed, was);
+
+    // Back to where the key is, from a read that didn't get to change it.
+    const uint32_t bounced = ~(filter->Pressed ^ was) & ~(pressed ^ was) & (pressed ^ previous);
+    if (bounced != 0) {
+        filter->Bounces += (uint64_t) __builtin_popcount(bounced);
+        for (uint32_t remaining = bounced; remaining != 0; remaining &= remaining - 1) {
+            buttons[filter->Buttons[__builtin_ctz(remaining)]].Bounces++;
+        }
+    }
+
+    for (unsigned int i = 0; i < numberOfButtons; i++) {
+        Button *button = buttons + i;
+        bool buttonPressed = (filter->Pressed & GpioPinMask(button->Gpio)) != 0;
+
+        switch (button->State) {
+            case BUTTON_STATE_IDLE:
+                if (buttonPressed) {
+                    button->State = BUTTON_STATE_PRESSED;
+                }
+                break;
+            case BUTTON_STATE_PRESSED:
+                if (!buttonPressed) {
+                    button->State = BUTTON_STATE_RELEASED;
+                }
+                break;
+            case BUTTON_STATE_RELEASED:
+                if (buttonPressed) {
+                    button->State = BUTTON_STATE_PRESSED;
+                } else {
+                    button->State = BUTTON_STATE_IDLE;
+                }
+                break;
+        }
+    }
+}
+
+int OpenButtonEvents(const char *chip, Button *const buttons, unsigned int numberOfButtons) {
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+
+    for(unsigned int i = 0; i < numberOfButtons; i++) {
+        buttons[i].State = BUTTON_STATE_IDLE;
+        request.offsets[i] = buttons[i].Gpio;
+    }
+    request.num_lines = numberOfButtons;
+
+    // Buttons pull the gpio to ground, so active low makes a rising edge a press.
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_ACTIVE_LOW | GPIO_V2_LINE_FLAG_BIAS_PULL_UP
+                           | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+
+    return RequestGpioLines(chip, &request);
+}
+
+unsigned int ReadButtonEvents(int file, Button *const buttons, unsigned int numberOfButtons,
+                              ButtonEvent *const events, unsigned int maxEvents) {
+    struct gpio_v2_line_event lineEvents[maxEvents];
+    ssize_t size = read(file, lineEvents, sizeof(lineEvents));
+    if(size < (ssize_t) sizeof(struct gpio_v2_line_event)) {
+        return 0;
+    }
+
+    unsigned int totalEvents = 0;
+    for(unsigned int i = 0; i < size / sizeof(struct gpio_v2_line_event); i++) {
+        struct gpio_v2_line_event *lineEvent = lineEvents + i;
+        for(unsigned int j = 0; j < numberOfButtons; j++) {
+            Button *button = buttons + j;
+            if(button->Gpio != lineEvent->offset) {
+                continue;
             }
+
+            bool pressed = lineEvent->id == GPIO_V2_LINE_EVENT_RISING_EDGE;
+            button->State = pressed ? BUTTON_STATE_PRESSED : BUTTON_STATE_RELEASED;
+            events[totalEvents].Button = button;
+            events[totalEvents].Pressed = pressed;
+            events[totalEvents].Timestamp = lineEvent->timestamp_ns;
+            totalEvents++;
             break;
+        }
+    }
+
+    return totalEvents;
+}
+
+// A consecutive button is pressed once its last Samples reads all are and released once none of them are.
+// The history is walked back once for every Samples in use, each step covering every button with that many.
+static uint32_t FilterConsecutive(const ButtonFilter *const filter, uint32_t was) {
+    uint32_t all = UINT32_MAX, any = 0;
+    uint32_t gpios = 0, pressed = 0, released = 0;
+    for (unsigned int samples = 1; samples <= filter->MaxSamples; samples++) {
+        const uint32_t read = filter->Reads[(filter->Next - samples) & (DEBOUNCE_MAX_SAMPLES - 1)];
+        all &= read;
+        any |= read;
+        gpios |= filter->Consecutive[samples];
+        pressed |= all & filter->Consecutive[samples];
+        released |= ~any & filter->Consecutive[samples];
     }
+
+    return pressed | (was & gpios & ~released);
+}
+
+// Each integrator counts up on a pressed read and down on a released one, within 0 and its button's Samples.
+// The counters are added to and taken from with a ripple carry down the slices, for every button at once.
+static uint32_t FilterIntegrated(ButtonFilter *const filter, uint32_t pressed, uint32_t was) {
+    if (filter->Integrated == 0) {
+        return 0;
+    }
+
+    static const uint32_t zero[DEBOUNCE_COUNTER_BITS];
+    uint32_t carry = pressed & filter->Integrated & ~GetCountersAt(filter->Counter, filter->Limit);
+    uint32_t borrow = ~pressed & filter->Integrated & ~GetCountersAt(filter->Counter, zero);
+    for (unsigned int bit = 0; bit < DEBOUNCE_COUNTER_BITS; bit++) {
+        const uint32_t counter = filter->Counter[bit];
+        filter->Counter[bit] = counter ^ carry ^ borrow;
+        carry &= counter;
+        borrow &= ~counter;
+    }
+
+    const uint32_t full = GetCountersAt(filter->Counter, filter->Limit) & filter->Integrated;
+    const uint32_t empty = GetCountersAt(filter->Counter, zero) & filter->Integrated;
+    return full | (was & filter->Integrated & ~empty);
+}
+
+// Gpios whose counter equals the sliced value.
+static uint32_t GetCountersAt(const uint32_t *const counter, const uint32_t *const value) {
+    uint32_t equal = UINT32_MAX;
+    for (unsigned int bit = 0; bit < DEBOUNCE_COUNTER_BITS; bit++) {
+        equal &= ~(counter[bit] ^ value[bit]);
+    }
+
+    return equal;
 }
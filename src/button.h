@@ -29,19 +29,40 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "GPIO.h"
 #include "uinput.h"
+#include "gpiochip.h"
 #include "SNESDevConfig.h"
 
+// consecutive: the last Samples reads must all agree before the key changes.
+// integrator: a counter goes up on each pressed read and down on each released one, the key changes at 0 and Samples.
+#define ENUM_DEBOUNCE_MODE(XX) \
+    XX(DEBOUNCE_NONE, =1, none) \
+    XX(DEBOUNCE_CONSECUTIVE, =2, consecutive) \
+    XX(DEBOUNCE_INTEGRATOR, =3, integrator)
+
+DECLARE_ENUM(DebounceMode, ENUM_DEBOUNCE_MODE)
+
+// A power of two, so the read history wraps with a mask.
+#define DEBOUNCE_MAX_SAMPLES 32
+
+// Bits of each integrator, enough to count up to DEBOUNCE_MAX_SAMPLES.
+#define DEBOUNCE_COUNTER_BITS 6
+
 typedef struct {
     unsigned int Id;
     InputKey Key;
     uint8_t DataGpio;
+    DebounceMode Debounce;
+    unsigned int Samples;
 } ButtonConfig;
 
 typedef struct {
     unsigned int Total;
     ButtonConfig Buttons[SNESDEV_MAX_BUTTONS];
-    unsigned int PollFrequency;
+    unsigned int PollFrequency; // Hz
+    bool Events;
+    char GpioChip[GPIO_CHIP_LENGTH];
 } ButtonsConfig;
 
 typedef enum {
@@ -54,8 +75,39 @@ typedef struct {
     uint8_t Gpio;
     InputKey Key;
     ButtonState State;
+    DebounceMode Debounce;
+    unsigned int Samples;
+    uint64_t Bounces; // Reads that went back before they changed the key
 } Button;
 
+// Every button is filtered at once, a bit per gpio in each word, so a read costs the same few word operations
+// however many buttons there are.
+typedef struct {
+    uint32_t Reads[DEBOUNCE_MAX_SAMPLES]; // Raw pressed gpios of the last reads, Reads[Next - 1] the newest
+    unsigned int Next;
+    unsigned int MaxSamples; // Of any consecutive button, how far back the history is looked at
+    uint32_t Pressed; // Debounced
+    uint32_t Gpios; // Of all the buttons
+    uint32_t Unfiltered; // Gpios of buttons with no debounce
+    uint32_t Consecutive[DEBOUNCE_MAX_SAMPLES + 1]; // Gpios of consecutive buttons, indexed by Samples
+    uint32_t Integrated; // Gpios of integrator buttons
+    uint32_t Counter[DEBOUNCE_COUNTER_BITS]; // Integrators, bit-sliced: word k holds bit k of every gpio's count
+    uint32_t Limit[DEBOUNCE_COUNTER_BITS]; // Samples of each integrator button, sliced the same way
+    uint8_t Buttons[GPIO_BANK_SIZE]; // Index of the button on each gpio
+    uint64_t Bounces; // Of every button
+} ButtonFilter;
+
+typedef struct {
+    Button *Button;
+    bool Pressed;
+    uint64_t Timestamp;
+} ButtonEvent;
+
 bool OpenButton(Button *button);
-void ReadButton(Button *button);
+void OpenButtonFilter(ButtonFilter *filter, const Button *buttons, unsigned int numberOfButtons);
+void ReadButtons(ButtonFilter *filter, Button *buttons, unsigned int numberOfButtons);
+
+// Edge events from the gpio character device, rather than polling.
+int OpenButtonEvents(const char *chip, Button *buttons, unsigned int numberOfButtons);
+unsigned int ReadButtonEvents(int file, Button *buttons, unsigned int numberOfButtons, ButtonEvent *events, unsigned int maxEvents);
 
@@ -0,0 +1,335 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syslog.h>
+
+#include "capture.h"
+#include "realtime.h"
+#include "scheduler.h"
+
+static size_t GetRecordSize(unsigned int clockPulses, unsigned int trains);
+static uint32_t GetDataMask(const GamepadsConfig *config);
+static bool OpenTape(GamepadTape *tape, const GamepadsConfig *config, bool playing);
+static bool StartWriter(Capture *capture);
+static void *RunWriter(void *data);
+static bool WriteAll(int file, const unsigned char *data, size_t length);
+
+bool OpenCapture(Capture *const capture, const char *const path, const GamepadsConfig *const config,
+                 const Gamepad *const gamepads) {
+    memset(capture, 0, sizeof(Capture));
+    capture->File = -1;
+    if(!OpenTape(&capture->Tape, config, false)) {
+        return false;
+    }
+    capture->RecordSize = GetRecordSize(capture->Tape.ClockPulses, capture->Tape.MaxTrains);
+    capture->BufferSize = capture->RecordSize < CAPTURE_BUFFER_SIZE
+                          ? CAPTURE_BUFFER_SIZE - CAPTURE_BUFFER_SIZE % capture->RecordSize
+                          : capture->RecordSize;
+
+    // Levels past a record's trains and padding are never written, so they stay zeroed.
+    capture->Buffers[0] = calloc(1, capture->BufferSize);
+    capture->Buffers[1] = calloc(1, capture->BufferSize);
+    if(capture->Buffers[0] == NULL || capture->Buffers[1] == NULL) {
+        fprintf(stderr, "Unable to allocate capture buffers\n");
+        CloseCapture(capture);
+        return false;
+    }
+
+    // Every write goes on the end, a crash loses at most the buffered records.
+    capture->File = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if(capture->File < 0) {
+        fprintf(stderr, "Unable to open capture %s: %s\n", path, strerror(errno));
+        CloseCapture(capture);
+        return false;
+    }
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    header.Version = CAPTURE_VERSION;
+    header.Gamepads = config->Total;
+    header.RecordSize = (uint32_t) capture->RecordSize;
+    header.ClockPulses = capture->Tape.ClockPulses;
+    header.Trains = capture->Tape.MaxTrains;
+    header.DataMask = GetDataMask(config);
+    for(unsigned int i = 0; i < config->Total; i++) {
+        header.Connected |= gamepads[i].Connected ? 1u << i : 0;
+    }
+    header.Start = MonotonicNanos();
+    if(!WriteAll(capture->File, (const unsigned char *) &header, sizeof(header))) {
+        fprintf(stderr, "Unable to write capture %s: %s\n", path, strerror(errno));
+        CloseCapture(capture);
+        return false;
+    }
+
+    return StartWriter(capture);
+}
+
+bool WriteCaptureRecord(Capture *const capture, uint64_t time) {
+    if(__atomic_load_n(&capture->Failed, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    const GamepadTape *tape = &capture->Tape;
+    CaptureRecord *record = (CaptureRecord *) (capture->Buffers[capture->Filling] + capture->Buffered);
+    record->Time = time;
+    record->Trains = tape->Trains;
+    memcpy(record->Levels, tape->Levels, tape->Trains * tape->ClockPulses * sizeof(uint32_t));
+
+    capture->Buffered += capture->RecordSize;
+    if(capture->Buffered + capture->RecordSize <= capture->BufferSize) {
+        return true;
+    }
+
+    // The sampler never waits on the disk, a full buffer with the writer still busy loses its newest record.
+    if(__atomic_load_n(&capture->Writing, __ATOMIC_ACQUIRE) != 0) {
+        capture->Buffered -= capture->RecordSize;
+        capture->Dropped++;
+        return true;
+    }
+
+    capture->Pending = capture->Filling;
+    __atomic_store_n(&capture->Writing, capture->Buffered, __ATOMIC_RELEASE);
+    sem_post(&capture->Ready);
+    capture->Filling ^= 1;
+    capture->Buffered = 0;
+    return true;
+}
+
+bool OpenReplay(Capture *const capture, const char *const path, const GamepadsConfig *const config,
+                Gamepad *const gamepads) {
+    memset(capture, 0, sizeof(Capture));
+
+    capture->File = open(path, O_RDONLY | O_CLOEXEC);
+    if(capture->File < 0) {
+        fprintf(stderr, "Unable to open replay %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat status;
+    if(fstat(capture->File, &status) < 0 || (size_t) status.st_size < sizeof(CaptureHeader)) {
+        fprintf(stderr, "Replay %s is too short\n", path);
+        CloseCapture(capture);
+        return false;
+    }
+
+    capture->Length = (size_t) status.st_size;
+    void *map = mmap(NULL, capture->Length, PROT_READ, MAP_PRIVATE, capture->File, 0);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "Unable to map replay %s: %s\n", path, strerror(errno));
+        capture->Length = 0;
+        CloseCapture(capture);
+        return false;
+    }
+    capture->Map = map;
+
+    const CaptureHeader *header = (const CaptureHeader *) capture->Map;
+    if(memcmp(header->Magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || header->Version != CAPTURE_VERSION ||
+       header->RecordSize != GetRecordSize(header->ClockPulses, header->Trains)) {
+        fprintf(stderr, "Replay %s isn't a capture\n", path);
+        CloseCapture(capture);
+        return false;
+    }
+
+    // The levels only mean the same thing read through the same buses and retries.
+    if(header->Gamepads != config->Total || header->ClockPulses != config->ClockPulses ||
+       header->Trains != 1 + config->Retries || header->DataMask != GetDataMask(config)) {
+        fprintf(stderr, "Replay %s was captured with other gamepads, buses or retries than are configured\n", path);
+        CloseCapture(capture);
+        return false;
+    }
+
+    if(!OpenTape(&capture->Tape, config, true)) {
+        CloseCapture(capture);
+        return false;
+    }
+
+    // Gamepads connected at the start of the capture were probed before it, they start out connected again.
+    for(unsigned int i = 0; i < config->Total; i++) {
+        gamepads[i].Connected = gamepads[i].Present = (header->Connected & (1u << i)) != 0;
+    }
+
+    // A record cut short by a crash is left off.
+    capture->RecordSize = header->RecordSize;
+    capture->Records = (capture->Length - sizeof(CaptureHeader)) / capture->RecordSize;
+    return true;
+}
+
+const CaptureRecord *PeekCaptureRecord(const Capture *const capture) {
+    if(capture->Next >= capture->Records) {
+        return NULL;
+    }
+
+    return (const CaptureRecord *) (capture->Map + sizeof(CaptureHeader) + capture->Next * capture->RecordSize);
+}
+
+// Puts the next record's levels on the tape, for ReadGamepads to play in place of reading the buses.
+bool LoadCaptureRecord(Capture *const capture) {
+    const CaptureRecord *record = PeekCaptureRecord(capture);
+    if(record == NULL) {
+        return false;
+    }
+
+    GamepadTape *tape = &capture->Tape;
+    tape->Trains = record->Trains < tape->MaxTrains ? record->Trains : tape->MaxTrains;
+    memcpy(tape->Levels, record->Levels, tape->Trains * tape->ClockPulses * sizeof(uint32_t));
+    capture->Next++;
+    return true;
+}
+
+void CloseCapture(Capture *const capture) {
+    if(capture->Started) {
+        __atomic_store_n(&capture->Stopping, true, __ATOMIC_RELEASE);
+        sem_post(&capture->Ready);
+        pthread_join(capture->Writer, NULL);
+        sem_destroy(&capture->Ready);
+        capture->Started = false;
+
+        // The writer is gone, whatever's left is written from here.
+        if(!capture->Failed && capture->Buffered > 0 &&
+           !WriteAll(capture->File, capture->Buffers[capture->Filling], capture->Buffered)) {
+            fprintf(stderr, "Unable to write capture: %s\n", strerror(errno));
+        }
+
+        if(capture->Dropped > 0) {
+            syslog(LOG_WARNING, "Capture: { Dropped: %llu }", (unsigned long long) capture->Dropped);
+        }
+    }
+
+    free(capture->Buffers[0]);
+    free(capture->Buffers[1]);
+    capture->Buffers[0] = capture->Buffers[1] = NULL;
+    free(capture->Tape.Levels);
+    capture->Tape.Levels = NULL;
+
+    if(capture->Map != NULL) {
+        munmap((void *) capture->Map, capture->Length);
+        capture->Map = NULL;
+    }
+
+    if(capture->File >= 0) {
+        close(capture->File);
+        capture->File = -1;
+    }
+}
+
+static size_t GetRecordSize(unsigned int clockPulses, unsigned int trains) {
+    const size_t size = sizeof(CaptureRecord) + (size_t) trains * clockPulses * sizeof(uint32_t);
+    return (size + 7) & ~(size_t) 7;
+}
+
+static uint32_t GetDataMask(const GamepadsConfig *const config) {
+    uint32_t mask = 0;
+    for(unsigned int i = 0; i < config->Total; i++) {
+        mask |= 1u << config->Gamepads[i].DataGpio;
+    }
+
+    return mask;
+}
+
+static bool OpenTape(GamepadTape *const tape, const GamepadsConfig *const config, bool playing) {
+    memset(tape, 0, sizeof(GamepadTape));
+    tape->MaxTrains = 1 + config->Retries;
+    tape->ClockPulses = config->ClockPulses;
+    tape->Playing = playing;
+    tape->Levels = calloc((size_t) tape->MaxTrains * tape->ClockPulses, sizeof(uint32_t));
+    if(tape->Levels == NULL) {
+        fprintf(stderr, "Unable to allocate a capture tape\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool StartWriter(Capture *const capture) {
+    if(sem_init(&capture->Ready, 0, 0) < 0) {
+        fprintf(stderr, "Unable to start the capture writer: %s\n", strerror(errno));
+        CloseCapture(capture);
+        return false;
+    }
+
+    // The writer blocks on the disk, so it never runs realtime, whatever the sampler does.
+    int error = StartThread(&capture->Writer, THREAD_PRIORITY_NORMAL, RunWriter, capture);
+
+    if(error != 0) {
+        fprintf(stderr, "Unable to start the capture writer: %s\n", strerror(error));
+        sem_destroy(&capture->Ready);
+        CloseCapture(capture);
+        return false;
+    }
+
+    capture->Started = true;
+    return true;
+}
+
+static void *RunWriter(void *data) {
+    Capture *capture = data;
+    for(;;) {
+        while(sem_wait(&capture->Ready) < 0 && errno == EINTR);
+
+        // Stopping comes after any last buffer handed over, so it's looked at first.
+        const bool stopping = __atomic_load_n(&capture->Stopping, __ATOMIC_ACQUIRE);
+        const size_t writing = __atomic_load_n(&capture->Writing, __ATOMIC_ACQUIRE);
+        if(writing > 0) {
+            if(!WriteAll(capture->File, capture->Buffers[capture->Pending], writing)) {
+                fprintf(stderr, "Unable to write capture: %s\n", strerror(errno));
+                __atomic_store_n(&capture->Failed, true, __ATOMIC_RELEASE);
+            }
+            __atomic_store_n(&capture->Writing, 0, __ATOMIC_RELEASE);
+        }
+
+        if(stopping) {
+            return NULL;
+        }
+    }
+}
+
+static bool WriteAll(const int file, const unsigned char *data, size_t length) {
+    while(length > 0) {
+        const ssize_t written = write(file, data, length);
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written <= 0) {
+            errno = written < 0 ? errno : EIO;
+            return false;
+        }
+
+        data += written;
+        length -= (size_t) written;
+    }
+
+    return true;
+}
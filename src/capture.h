@@ -0,0 +1,98 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gamepad.h"
+
+#define CAPTURE_MAGIC "SNESCAP"
+#define CAPTURE_VERSION 2
+
+// Records are buffered in blocks of about this many bytes, one block is written while the next fills.
+#define CAPTURE_BUFFER_SIZE 65536
+
+// A capture file is this header followed by fixed size records, one per frame, in the order they were read.
+// Everything is native endian and 8 byte aligned, so a capture can be mapped and indexed as it is.
+typedef struct {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t Gamepads;
+    uint32_t RecordSize; // Bytes, a multiple of 8
+    uint32_t ClockPulses; // Level words in a train
+    uint32_t Trains; // Room for in a record, 1 + Retries
+    uint32_t DataMask; // Data gpios of the gamepads, the bits of a level word that mean anything
+    uint32_t Connected; // Bit per gamepad connected when the capture was opened
+    uint32_t Reserved;
+    uint64_t Start; // Monotonic ns the capture was opened
+} CaptureHeader;
+
+// The levels are as read off the buses, before any validation, so a replay goes through the same checks.
+typedef struct {
+    uint64_t Time; // Monotonic ns the frame was latched
+    uint32_t Trains; // Read in the frame, the rest of Levels is unused
+    uint32_t Reserved;
+    uint32_t Levels[]; // Trains of ClockPulses level words
+} CaptureRecord;
+
+typedef struct {
+    int File;
+    size_t RecordSize;
+    GamepadTape Tape;
+
+    // Capturing, a writer thread writes out one buffer while the sampler fills the other.
+    unsigned char *Buffers[2];
+    unsigned int Filling;
+    size_t Buffered;
+    size_t BufferSize;
+    unsigned int Pending; // Buffer handed to the writer
+    size_t Writing; // Bytes of it still to be written, 0 once they are
+    bool Stopping;
+    bool Failed;
+    uint64_t Dropped; // Records lost while the writer was behind
+    sem_t Ready;
+    pthread_t Writer;
+    bool Started;
+
+    // Replaying
+    const unsigned char *Map;
+    size_t Length;
+    size_t Records;
+    size_t Next;
+} Capture;
+
+bool OpenCapture(Capture *capture, const char *path, const GamepadsConfig *config, const Gamepad *gamepads);
+bool WriteCaptureRecord(Capture *capture, uint64_t time);
+bool OpenReplay(Capture *capture, const char *path, const GamepadsConfig *config, Gamepad *gamepads);
+const CaptureRecord *PeekCaptureRecord(const Capture *capture);
+bool LoadCaptureRecord(Capture *capture);
+void CloseCapture(Capture *capture);
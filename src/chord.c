@@ -0,0 +1,85 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "chord.h"
+
+#define NANOS_PER_MILLISECOND 1000000ULL
+
+static bool IsChordHeld(const Chord *chord, const Gamepad *gamepads, unsigned int numberOfGamepads);
+
+void OpenChords(Chords *const chords, const ChordsConfig *const config, InputDevice *const keyboard, unsigned int verbose) {
+    memset(chords, 0, sizeof(Chords));
+    chords->Total = config->Total;
+    chords->Keyboard = keyboard;
+    chords->Verbose = verbose;
+
+    for(unsigned int i = 0; i < config->Total; i++) {
+        const ChordConfig *chordConfig = config->Chords + i;
+        Chord *chord = chords->Chords + i;
+        chord->Id = chordConfig->Id;
+        chord->Buttons = chordConfig->Buttons;
+        chord->Key = chordConfig->Key;
+        chord->Hold = (uint64_t) chordConfig->Hold * NANOS_PER_MILLISECOND;
+    }
+}
+
+void ProcessChords(Chords *const chords, const Gamepad *const gamepads, unsigned int numberOfGamepads, uint64_t latched) {
+    for(unsigned int i = 0; i < chords->Total; i++) {
+        Chord *chord = chords->Chords + i;
+
+        const bool held = IsChordHeld(chord, gamepads, numberOfGamepads);
+        if(held && !chord->Held) {
+            chord->HeldSince = latched;
+        }
+        chord->Held = held;
+
+        // Down once held for long enough, up as soon as any of the buttons is let go.
+        const bool pressed = held && latched - chord->HeldSince >= chord->Hold;
+        if(pressed == chord->Pressed) {
+            continue;
+        }
+
+        chord->Pressed = pressed;
+        QueueKey(chords->Keyboard, chord->Key, pressed);
+        if(chords->Verbose && pressed) {
+            printf("Chord %u pressed, triggered key: %s\n", chord->Id, GetInputKeyString(chord->Key));
+        }
+    }
+}
+
+static bool IsChordHeld(const Chord *const chord, const Gamepad *const gamepads, unsigned int numberOfGamepads) {
+    for(unsigned int i = 0; i < numberOfGamepads; i++) {
+        if(gamepads[i].Connected && (gamepads[i].State & chord->Buttons) == chord->Buttons) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,69 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gamepad.h"
+#include "uinput.h"
+#include "SNESDevConfig.h"
+
+// A key sent while any one gamepad holds all of a set of buttons, e.g. SELECT+START for ESC.
+typedef struct {
+    unsigned int Id;
+    uint16_t Buttons; // Mask of ENUM_GAMEPAD_BUTTON
+    InputKey Key;
+    unsigned int Hold; // ms the buttons must be held before the key is pressed
+} ChordConfig;
+
+typedef struct {
+    unsigned int Total;
+    ChordConfig Chords[SNESDEV_MAX_CHORDS];
+} ChordsConfig;
+
+typedef struct {
+    unsigned int Id;
+    uint16_t Buttons;
+    InputKey Key;
+    uint64_t Hold; // ns
+    bool Held; // Some gamepad holds all of Buttons
+    uint64_t HeldSince; // Latched ns Held was first seen
+    bool Pressed; // Key is down
+} Chord;
+
+// Keys are only queued on Keyboard, whoever owns it flushes them along with its own.
+typedef struct {
+    unsigned int Total;
+    Chord Chords[SNESDEV_MAX_CHORDS];
+    InputDevice *Keyboard;
+    unsigned int Verbose;
+} Chords;
+
+void OpenChords(Chords *chords, const ChordsConfig *config, InputDevice *keyboard, unsigned int verbose);
+void ProcessChords(Chords *chords, const Gamepad *gamepads, unsigned int numberOfGamepads, uint64_t latched);
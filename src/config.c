@@ -4,7 +4,10 @@
 #include <stdlib.h>
 #include <argp.h>
 #include <string.h>
+#include <sched.h>
+#include <ctype.h>
 #include "config.h"
+#include "GPIO.h"
 
 // Arguments
 #define OPT_USAGE ""
@@ -13,12 +16,24 @@
 #define OPT_VERBOSE 'v'
 #define OPT_DAEMON 'd'
 #define OPT_PIDFILE 'p'
+#define OPT_CONFIG 'c'
+#define OPT_GPIO 'g'
+#define OPT_SIM_SCRIPT -2
+#define OPT_GPIO_CHIP -3
+#define OPT_CAPTURE -4
+#define OPT_REPLAY -5
 
 typedef struct {
     unsigned int Verbose;
     bool RunAsDaemon;
     bool DebugEnabled;
     const char *PidFile;
+    const char *ConfigFile;
+    const char *GpioBackend;
+    const char *SimScript;
+    const char *GpioChip;
+    const char *CaptureFile;
+    const char *ReplayFile;
 } Arguments;
 
 static const struct argp_option options[] = {
@@ -26,47 +41,130 @@ static const struct argp_option options[] = {
         { "daemon", OPT_DAEMON, 0, 0, "Run as a daemon", 0 },
         { "debug", OPT_DEBUG, 0, 0, "Run with debug options set in gpio library", 0 },
         { "pidfile", OPT_PIDFILE, "FILE", 0, "Write PID to FILE", 0 },
+        { "config", OPT_CONFIG, "FILE", 0, "Read config from FILE instead of " CONFIG_FILE, 0 },
+        { "gpio", OPT_GPIO, "BACKEND", 0, "Gpio backend: bcm2835, chardev or sim, default is " SNESDEV_GPIO_BACKEND, 0 },
+        { "gpio-chip", OPT_GPIO_CHIP, "FILE", 0, "Gpio character device for the chardev backend, default is /dev/gpiochip0", 0 },
+        { "sim-script", OPT_SIM_SCRIPT, "FILE", 0, "Drive the simulated gpio backend from FILE", 0 },
+        { "capture", OPT_CAPTURE, "FILE", 0, "Record every gamepad frame to FILE", 0 },
+        { "replay", OPT_REPLAY, "FILE", 0, "Play gamepad frames recorded with --capture back instead of reading gpio", 0 },
         { 0 }
 };
 
 // Config file.
 #define CFG_CLOCK_GPIO "ClockGpio"
 #define CFG_LATCH_GPIO "LatchGpio"
+#define CFG_LATCH_HIGH "LatchHigh"
+#define CFG_LATCH_LOW "LatchLow"
+#define CFG_CLOCK_LOW "ClockLow"
+#define CFG_CLOCK_HIGH "ClockHigh"
 
 #define CFG_ENABLED "Enabled"
 #define CFG_GPIO "Gpio"
 #define CFG_KEY "Key"
 #define CFG_POLL_FREQ "PollFrequency"
+#define CFG_IDLE_FREQ "IdleFrequency"
+#define CFG_IDLE_TIMEOUT "IdleTimeout"
 
 #define CFG_GAMEPADS "Gamepads"
 #define CFG_GAMEPAD "Gamepad"
 #define CFG_GAMEPAD_TYPE "Type"
+#define CFG_BUS "Bus"
+#define CFG_RETRIES "Retries"
+#define CFG_OVERSAMPLE "Oversample"
+#define CFG_DETECT_PRESENCE "DetectPresence"
+#define CFG_CONNECT_FRAMES "ConnectFrames"
+#define CFG_DISCONNECT_FRAMES "DisconnectFrames"
+#define CFG_MAP "Map"
+#define CFG_MAP_BUTTON(name, assign, prettyName) CFG_STR(#prettyName, NULL, CFGF_NONE),
+#define CFG_TURBO "Turbo"
+#define CFG_TURBO_BUTTON(name, assign, prettyName) CFG_INT(#prettyName, 0, CFGF_NONE),
 
 #define CFG_BUTTONS "Buttons"
 #define CFG_BUTTON "Button"
+#define CFG_EVENTS "Events"
+#define CFG_DEBOUNCE "Debounce"
+#define CFG_SAMPLES "Samples"
+#define CFG_GPIO_CHIP "GpioChip"
+
+#define CFG_CHORDS "Chords"
+#define CFG_CHORD "Chord"
+#define CFG_HOLD "Hold"
+
+#define CFG_REALTIME "Realtime"
+#define CFG_PRIORITY "Priority"
+#define CFG_LOCK_MEMORY "LockMemory"
+#define CFG_CPU "Cpu"
+
+#define CFG_SYNC "Sync"
+#define CFG_SOURCE "Source"
+#define CFG_SOCKET "Socket"
+#define CFG_SOCKET_GROUP "SocketGroup"
+#define CFG_LATCH_ADVANCE "LatchAdvance"
 
 static Arguments ParseArguments(int argc, char **argv);
 static error_t ParseOption(int key, char *arg, struct argp_state *state);
 static bool ValidateConfig(SNESDevConfig *config);
 static int VerifyGamepadType(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result);
 static int VerifyInputKey(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result);
+static int VerifySyncSource(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result);
+static int VerifyDebounceMode(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result);
+static int VerifyChordButtons(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result);
 static inline unsigned int SafeToUnsigned(long x);
+static int FindBus(const GamepadsConfig *config, unsigned int id);
+static bool ParseGamepadMap(cfg_t *mapSection, GamepadConfig *gamepad, InputCodes *keyboard);
+static bool ParseMapTarget(const char *target, GamepadButtonEvent *event);
+static bool ParseGamepadTurbo(cfg_t *turboSection, GamepadConfig *gamepad, unsigned int pollFrequency);
 
 bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNESDevConfig *const config) {
     const Arguments arguments = ParseArguments(argc, argv);
+    if(arguments.ConfigFile != NULL) {
+        fileName = arguments.ConfigFile;
+    }
+
+    cfg_opt_t MapOpts[] = {
+            ENUM_GAMEPAD_BUTTON(CFG_MAP_BUTTON)
+            CFG_END()
+    };
+
+    cfg_opt_t TurboOpts[] = {
+            ENUM_GAMEPAD_BUTTON(CFG_TURBO_BUTTON)
+            CFG_END()
+    };
 
     cfg_opt_t GamepadOpts[] = {
             CFG_BOOL(CFG_ENABLED, cfg_false, CFGF_NONE),
             CFG_INT(CFG_GPIO, 0, CFGF_NONE),
+            CFG_INT(CFG_BUS, 0, CFGF_NONE),
+            CFG_SEC(CFG_MAP, MapOpts, CFGF_NONE),
+            CFG_SEC(CFG_TURBO, TurboOpts, CFGF_NONE),
+            CFG_END()
+    };
+
+    cfg_opt_t BusOpts[] = {
+            CFG_INT_CB(CFG_GAMEPAD_TYPE, 0, CFGF_NONE, &VerifyGamepadType),
+            CFG_INT(CFG_CLOCK_GPIO, 0, CFGF_NONE),
+            CFG_INT(CFG_LATCH_GPIO, 0, CFGF_NONE),
             CFG_END()
     };
 
     cfg_opt_t GamepadsOpts[] = {
             CFG_SEC(CFG_GAMEPAD, GamepadOpts, CFGF_MULTI | CFGF_TITLE),
+            CFG_SEC(CFG_BUS, BusOpts, CFGF_MULTI | CFGF_TITLE),
             CFG_INT_CB(CFG_GAMEPAD_TYPE, 0, CFGF_NONE, &VerifyGamepadType),
             CFG_INT(CFG_CLOCK_GPIO, 0, CFGF_NONE),
             CFG_INT(CFG_LATCH_GPIO, 0, CFGF_NONE),
             CFG_INT(CFG_POLL_FREQ, 0, CFGF_NONE),
+            CFG_INT(CFG_IDLE_FREQ, 0, CFGF_NONE),
+            CFG_INT(CFG_IDLE_TIMEOUT, 5, CFGF_NONE),
+            CFG_INT(CFG_LATCH_HIGH, 12000, CFGF_NONE),
+            CFG_INT(CFG_LATCH_LOW, 6000, CFGF_NONE),
+            CFG_INT(CFG_CLOCK_LOW, 6000, CFGF_NONE),
+            CFG_INT(CFG_CLOCK_HIGH, 6000, CFGF_NONE),
+            CFG_INT(CFG_RETRIES, 2, CFGF_NONE),
+            CFG_INT(CFG_OVERSAMPLE, 1, CFGF_NONE),
+            CFG_BOOL(CFG_DETECT_PRESENCE, cfg_false, CFGF_NONE),
+            CFG_INT(CFG_CONNECT_FRAMES, 3, CFGF_NONE),
+            CFG_INT(CFG_DISCONNECT_FRAMES, 15, CFGF_NONE),
             CFG_END()
     };
 
@@ -74,18 +172,53 @@ bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNES
             CFG_BOOL(CFG_ENABLED, cfg_false, CFGF_NONE),
             CFG_INT_CB(CFG_KEY, 0, CFGF_NONE, &VerifyInputKey),
             CFG_INT(CFG_GPIO, 0, CFGF_NONE),
+            CFG_INT_CB(CFG_DEBOUNCE, DEBOUNCE_NONE, CFGF_NONE, &VerifyDebounceMode),
+            CFG_INT(CFG_SAMPLES, 3, CFGF_NONE),
             CFG_END()
     };
 
     cfg_opt_t ButtonsOpts[] = {
             CFG_SEC(CFG_BUTTON, ButtonOpts, CFGF_MULTI | CFGF_TITLE),
             CFG_INT(CFG_POLL_FREQ, 0, CFGF_NONE),
+            CFG_BOOL(CFG_EVENTS, cfg_false, CFGF_NONE),
+            CFG_STR(CFG_GPIO_CHIP, "/dev/gpiochip0", CFGF_NONE),
+            CFG_END()
+    };
+
+    cfg_opt_t ChordOpts[] = {
+            CFG_BOOL(CFG_ENABLED, cfg_true, CFGF_NONE),
+            CFG_INT_CB(CFG_BUTTONS, 0, CFGF_NONE, &VerifyChordButtons),
+            CFG_INT_CB(CFG_KEY, 0, CFGF_NONE, &VerifyInputKey),
+            CFG_INT(CFG_HOLD, 0, CFGF_NONE),
+            CFG_END()
+    };
+
+    cfg_opt_t ChordsOpts[] = {
+            CFG_SEC(CFG_CHORD, ChordOpts, CFGF_MULTI | CFGF_TITLE),
+            CFG_END()
+    };
+
+    cfg_opt_t RealtimeOpts[] = {
+            CFG_INT(CFG_PRIORITY, 0, CFGF_NONE),
+            CFG_BOOL(CFG_LOCK_MEMORY, cfg_false, CFGF_NONE),
+            CFG_INT(CFG_CPU, -1, CFGF_NONE),
+            CFG_END()
+    };
+
+    cfg_opt_t SyncOpts[] = {
+            CFG_INT_CB(CFG_SOURCE, SYNC_SOURCE_NONE, CFGF_NONE, &VerifySyncSource),
+            CFG_STR(CFG_SOCKET, "/run/snesdev.sock", CFGF_NONE),
+            CFG_STR(CFG_SOCKET_GROUP, "", CFGF_NONE),
+            CFG_INT(CFG_LATCH_ADVANCE, 2000, CFGF_NONE),
             CFG_END()
     };
 
     cfg_opt_t opts[] = {
             CFG_SEC(CFG_GAMEPADS, GamepadsOpts, CFGF_NONE),
             CFG_SEC(CFG_BUTTONS, ButtonsOpts, CFGF_NONE),
+            CFG_SEC(CFG_CHORDS, ChordsOpts, CFGF_NONE),
+            CFG_SEC(CFG_REALTIME, RealtimeOpts, CFGF_NONE),
+            CFG_SEC(CFG_SYNC, SyncOpts, CFGF_NONE),
             CFG_END()
     };
 
@@ -106,18 +239,67 @@ bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNES
     // PidFile came from argv so will be way down teh stack :-)
     config->PidFile = arguments.PidFile;
 
+    config->Gpio.Backend = GetGpioBackendTypeValue(arguments.GpioBackend);
+    config->Gpio.DebugEnabled = arguments.DebugEnabled;
+    config->Gpio.SimScript = arguments.SimScript;
+    config->Gpio.GpioChip = arguments.GpioChip;
+    config->CaptureFile = arguments.CaptureFile;
+    config->ReplayFile = arguments.ReplayFile;
+
+    // A replay needs no hardware.
+    if(config->ReplayFile != NULL) {
+        config->Gpio.Backend = GPIO_BACKEND_SIM;
+    }
+
     // Parse gamepad section
     GamepadsConfig *gamepadsConfig = &config->Gamepads;
     cfg_t *gamepadsSection = cfg_getsec(cfg, CFG_GAMEPADS);
-    gamepadsConfig->ClockGpio = (uint8_t) SafeToUnsigned(cfg_getint(gamepadsSection, CFG_CLOCK_GPIO));
-    gamepadsConfig->LatchGpio = (uint8_t) SafeToUnsigned(cfg_getint(gamepadsSection, CFG_LATCH_GPIO));
+    gamepadsConfig->PollFrequency = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_POLL_FREQ));
+    gamepadsConfig->IdleFrequency = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_IDLE_FREQ));
+    gamepadsConfig->IdleTimeout = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_IDLE_TIMEOUT));
+    gamepadsConfig->LatchHigh = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_LATCH_HIGH));
+    gamepadsConfig->LatchLow = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_LATCH_LOW));
+    gamepadsConfig->ClockLow = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_CLOCK_LOW));
+    gamepadsConfig->ClockHigh = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_CLOCK_HIGH));
+    gamepadsConfig->Retries = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_RETRIES));
+    gamepadsConfig->Oversample = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_OVERSAMPLE));
+    gamepadsConfig->DetectPresence = cfg_getbool(gamepadsSection, CFG_DETECT_PRESENCE) ? true : false;
+    gamepadsConfig->ConnectFrames = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_CONNECT_FRAMES));
+    gamepadsConfig->DisconnectFrames = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_DISCONNECT_FRAMES));
+    unsigned int numberOfBuses = cfg_size(gamepadsSection, CFG_BUS);
+    unsigned int numberOfGamepads = cfg_size(gamepadsSection, CFG_GAMEPAD);
 
-    unsigned int pollFrequency = SafeToUnsigned(cfg_getint(gamepadsSection, CFG_POLL_FREQ));
-    if(pollFrequency > 0) {
-        gamepadsConfig->PollFrequency = (unsigned int)(1000 / (double)pollFrequency);
+    // Sized for every declared gamepad, the gpio bank is the only real limit.
+    gamepadsConfig->Buses = calloc(numberOfBuses > 0 ? numberOfBuses : 1, sizeof(GamepadBusConfig));
+    gamepadsConfig->Gamepads = calloc(numberOfGamepads > 0 ? numberOfGamepads : 1, sizeof(GamepadConfig));
+    if(gamepadsConfig->Buses == NULL || gamepadsConfig->Gamepads == NULL) {
+        fprintf(stderr, "Unable to allocate %u gamepads\n", numberOfGamepads);
+        FreeSNESDevConfig(config);
+        cfg_free(cfg);
+        return false;
+    }
+
+    // Parse buses
+    // Without any Bus sections, the clock, latch and type of the Gamepads section make up the only one.
+    if(numberOfBuses == 0) {
+        GamepadBusConfig *busConfig = gamepadsConfig->Buses;
+        busConfig->Id = 1;
+        busConfig->Type = (GamepadType) cfg_getint(gamepadsSection, CFG_GAMEPAD_TYPE);
+        busConfig->ClockGpio = (uint8_t) SafeToUnsigned(cfg_getint(gamepadsSection, CFG_CLOCK_GPIO));
+        busConfig->LatchGpio = (uint8_t) SafeToUnsigned(cfg_getint(gamepadsSection, CFG_LATCH_GPIO));
+        gamepadsConfig->TotalBuses = 1;
+    }
+
+    for(unsigned int i = 0; i < numberOfBuses; i++) {
+        cfg_t *busSection = cfg_getnsec(gamepadsSection, CFG_BUS, i);
+
+        GamepadBusConfig *busConfig = gamepadsConfig->Buses + gamepadsConfig->TotalBuses;
+        busConfig->Id = (unsigned int) atoi(cfg_title(busSection));
+        busConfig->Type = (GamepadType) cfg_getint(busSection, CFG_GAMEPAD_TYPE);
+        busConfig->ClockGpio = (uint8_t) SafeToUnsigned(cfg_getint(busSection, CFG_CLOCK_GPIO));
+        busConfig->LatchGpio = (uint8_t) SafeToUnsigned(cfg_getint(busSection, CFG_LATCH_GPIO));
+        gamepadsConfig->TotalBuses++;
     }
-    gamepadsConfig->Type = (GamepadType)cfg_getint(gamepadsSection, CFG_GAMEPAD_TYPE);
-    unsigned int numberOfGamepads = cfg_size(gamepadsSection, CFG_GAMEPAD);
 
     // Parse gamepads
     // TODO: Sort by gamepad id.
@@ -132,20 +314,33 @@ bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNES
         GamepadConfig *gamepadConfig = gamepadsConfig->Gamepads + gamepadsConfig->Total;
         gamepadConfig->Id = (unsigned int) atoi(cfg_title(gamepadSection));
         gamepadConfig->DataGpio = (uint8_t) SafeToUnsigned(cfg_getint(gamepadSection, CFG_GPIO));
-        gamepadsConfig->Total++;
 
-        if(gamepadsConfig->Total > SNESDEV_MAX_GAMEPADS) {
-            break;
+        // Gamepads without a bus go on the first one.
+        unsigned int busId = SafeToUnsigned(cfg_getint(gamepadSection, CFG_BUS));
+        int bus = busId == 0 ? 0 : FindBus(gamepadsConfig, busId);
+        if(bus < 0) {
+            fprintf(stderr, "Gamepad %u %s %u is not declared\n", gamepadConfig->Id, CFG_BUS, busId);
+            FreeSNESDevConfig(config);
+            cfg_free(cfg);
+            return false;
         }
+        gamepadConfig->Bus = (unsigned int) bus;
+
+        if(!ParseGamepadMap(cfg_getsec(gamepadSection, CFG_MAP), gamepadConfig, &config->Keyboard) ||
+           !ParseGamepadTurbo(cfg_getsec(gamepadSection, CFG_TURBO), gamepadConfig, gamepadsConfig->PollFrequency)) {
+            FreeSNESDevConfig(config);
+            cfg_free(cfg);
+            return false;
+        }
+        gamepadsConfig->Total++;
     }
 
     // Parse buttons section.
     ButtonsConfig *buttonsConfig = &config->Buttons;
     cfg_t *buttonsSection = cfg_getsec(cfg, CFG_BUTTONS);
-    pollFrequency = SafeToUnsigned(cfg_getint(buttonsSection, CFG_POLL_FREQ));
-    if(pollFrequency > 0) {
-        buttonsConfig->PollFrequency = (unsigned int) (1000 / (double)pollFrequency);
-    }
+    buttonsConfig->PollFrequency = SafeToUnsigned(cfg_getint(buttonsSection, CFG_POLL_FREQ));
+    buttonsConfig->Events = cfg_getbool(buttonsSection, CFG_EVENTS) ? true : false;
+    strncpy(buttonsConfig->GpioChip, cfg_getstr(buttonsSection, CFG_GPIO_CHIP), sizeof(buttonsConfig->GpioChip) - 1);
     unsigned int numberOfButtons = cfg_size(buttonsSection, CFG_BUTTON);
 
     // Parse buttons
@@ -162,6 +357,9 @@ bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNES
         buttonConfig->Id = (unsigned int) atoi(cfg_title(buttonSection));
         buttonConfig->Key = (InputKey) cfg_getint(buttonSection, CFG_KEY);
         buttonConfig->DataGpio = (uint8_t) SafeToUnsigned(cfg_getint(buttonSection, CFG_GPIO));
+        buttonConfig->Debounce = (DebounceMode) cfg_getint(buttonSection, CFG_DEBOUNCE);
+        buttonConfig->Samples = SafeToUnsigned(cfg_getint(buttonSection, CFG_SAMPLES));
+        AddInputCode(&config->Keyboard, EV_KEY, (unsigned short int) buttonConfig->Key);
         buttonsConfig->Total++;
 
         if(buttonsConfig->Total > SNESDEV_MAX_BUTTONS) {
@@ -169,15 +367,61 @@ bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNES
         }
     }
 
+    // Parse chords section.
+    ChordsConfig *chordsConfig = &config->Chords;
+    cfg_t *chordsSection = cfg_getsec(cfg, CFG_CHORDS);
+    unsigned int numberOfChords = cfg_size(chordsSection, CFG_CHORD);
+    for (unsigned int i = 0; i < numberOfChords && chordsConfig->Total < SNESDEV_MAX_CHORDS; i++) {
+        cfg_t *chordSection = cfg_getnsec(chordsSection, CFG_CHORD, i);
+
+        bool enabled = cfg_getbool(chordSection, CFG_ENABLED) ? true : false;
+        if(!enabled) {
+            continue;
+        }
+
+        ChordConfig *chordConfig = chordsConfig->Chords + chordsConfig->Total;
+        chordConfig->Id = (unsigned int) atoi(cfg_title(chordSection));
+        chordConfig->Buttons = (uint16_t) cfg_getint(chordSection, CFG_BUTTONS);
+        chordConfig->Key = (InputKey) cfg_getint(chordSection, CFG_KEY);
+        chordConfig->Hold = SafeToUnsigned(cfg_getint(chordSection, CFG_HOLD));
+        AddInputCode(&config->Keyboard, EV_KEY, (unsigned short int) chordConfig->Key);
+        chordsConfig->Total++;
+    }
+
+    // Parse realtime section.
+    RealtimeConfig *realtimeConfig = &config->Realtime;
+    cfg_t *realtimeSection = cfg_getsec(cfg, CFG_REALTIME);
+    realtimeConfig->Priority = SafeToUnsigned(cfg_getint(realtimeSection, CFG_PRIORITY));
+    realtimeConfig->LockMemory = cfg_getbool(realtimeSection, CFG_LOCK_MEMORY) ? true : false;
+    realtimeConfig->Cpu = (int) cfg_getint(realtimeSection, CFG_CPU);
+
+    // Parse sync section.
+    SyncConfig *syncConfig = &config->Sync;
+    cfg_t *syncSection = cfg_getsec(cfg, CFG_SYNC);
+    syncConfig->Source = (SyncSource) cfg_getint(syncSection, CFG_SOURCE);
+    strncpy(syncConfig->Socket, cfg_getstr(syncSection, CFG_SOCKET), sizeof(syncConfig->Socket) - 1);
+    strncpy(syncConfig->SocketGroup, cfg_getstr(syncSection, CFG_SOCKET_GROUP), sizeof(syncConfig->SocketGroup) - 1);
+    syncConfig->LatchAdvance = SafeToUnsigned(cfg_getint(syncSection, CFG_LATCH_ADVANCE));
+
     cfg_free(cfg);
 
     if(!ValidateConfig(config)) {
+        FreeSNESDevConfig(config);
         return false;
     }
 
     return true;
 }
 
+void FreeSNESDevConfig(SNESDevConfig *const config) {
+    free(config->Gamepads.Gamepads);
+    free(config->Gamepads.Buses);
+    config->Gamepads.Gamepads = NULL;
+    config->Gamepads.Buses = NULL;
+    config->Gamepads.Total = 0;
+    config->Gamepads.TotalBuses = 0;
+}
+
 
 static bool ValidateConfig(SNESDevConfig *const config) {
     if(config->RunAsDaemon && config->PidFile == NULL) {
@@ -185,21 +429,73 @@ static bool ValidateConfig(SNESDevConfig *const config) {
         return false;
     }
 
+    if(config->Gpio.Backend == 0) {
+        fprintf(stderr, "Gpio backend must be bcm2835, chardev or sim\n");
+        return false;
+    }
+
     if(config->Gamepads.PollFrequency == 0) {
         fprintf(stderr, "Gamepad %s must be > 0\n", CFG_POLL_FREQ);
         return false;
     }
 
-    if(config->Gamepads.ClockGpio == 0) {
-        fprintf(stderr, "%s must be > 0\n", CFG_CLOCK_GPIO);
+    if(config->Gamepads.IdleFrequency > config->Gamepads.PollFrequency) {
+        fprintf(stderr, "Gamepad %s must be <= %s\n", CFG_IDLE_FREQ, CFG_POLL_FREQ);
+        return false;
+    }
+
+    if(config->Sync.Source != SYNC_SOURCE_NONE && config->Gamepads.IdleFrequency > 0) {
+        fprintf(stderr, "Gamepad %s can't be used with a %s %s\n", CFG_IDLE_FREQ, CFG_SYNC, CFG_SOURCE);
+        return false;
+    }
+
+    if(config->Sync.Source != SYNC_SOURCE_NONE && config->Sync.LatchAdvance >= 1000000 / config->Gamepads.PollFrequency) {
+        fprintf(stderr, "%s %s must be less than a gamepad poll period\n", CFG_SYNC, CFG_LATCH_ADVANCE);
+        return false;
+    }
+
+    if(config->CaptureFile != NULL && config->ReplayFile != NULL) {
+        fprintf(stderr, "Can't capture and replay at the same time\n");
+        return false;
+    }
+
+    if(config->ReplayFile != NULL && config->Sync.Source != SYNC_SOURCE_NONE) {
+        fprintf(stderr, "A replay can't be used with a %s %s\n", CFG_SYNC, CFG_SOURCE);
         return false;
     }
 
-    if(config->Gamepads.LatchGpio == 0) {
-        fprintf(stderr, "%s must be > 0\n", CFG_LATCH_GPIO);
+    if(config->Gamepads.Oversample != 1 && config->Gamepads.Oversample != 3 && config->Gamepads.Oversample != 5) {
+        fprintf(stderr, "Gamepad %s must be 1, 3 or 5\n", CFG_OVERSAMPLE);
         return false;
     }
 
+    // Every bus is pulsed and every gamepad read from the same register accesses, so no two can share a pin.
+    uint32_t usedGpios = 0;
+    for(unsigned int i = 0; i < config->Gamepads.TotalBuses; i++) {
+        GamepadBusConfig *bus = config->Gamepads.Buses + i;
+        if(bus->Type == 0) {
+            fprintf(stderr, "%s %u %s must be snes or nes\n", CFG_BUS, bus->Id, CFG_GAMEPAD_TYPE);
+            return false;
+        }
+
+        if(bus->ClockGpio == 0 || bus->ClockGpio >= GPIO_BANK_SIZE) {
+            fprintf(stderr, "%s %u %s must be > 0 and < %u\n", CFG_BUS, bus->Id, CFG_CLOCK_GPIO, GPIO_BANK_SIZE);
+            return false;
+        }
+
+        if(bus->LatchGpio == 0 || bus->LatchGpio >= GPIO_BANK_SIZE) {
+            fprintf(stderr, "%s %u %s must be > 0 and < %u\n", CFG_BUS, bus->Id, CFG_LATCH_GPIO, GPIO_BANK_SIZE);
+            return false;
+        }
+
+        const uint32_t busGpios = GpioPinMask(bus->ClockGpio) | GpioPinMask(bus->LatchGpio);
+        if(bus->ClockGpio == bus->LatchGpio || (usedGpios & busGpios)) {
+            fprintf(stderr, "%s %u gpios are already in use\n", CFG_BUS, bus->Id);
+            return false;
+        }
+        usedGpios |= busGpios;
+    }
+
     if(config->Gamepads.Total == 0) {
         fprintf(stderr, "No gamepads configured\n");
         return false;
@@ -207,10 +503,34 @@ static bool ValidateConfig(SNESDevConfig *const config) {
 
     for(unsigned int i = 0; i < config->Gamepads.Total; i++) {
         GamepadConfig *gamepad = config->Gamepads.Gamepads + i;
-        if(gamepad == NULL || gamepad->DataGpio == 0 || gamepad->Id == 0 || gamepad->Id > SNESDEV_MAX_GAMEPADS) {
+        if(gamepad->DataGpio == 0 || gamepad->DataGpio >= GPIO_BANK_SIZE || gamepad->Id == 0) {
             fprintf(stderr, "Bad gamepad config\n");
             return false;
         }
+
+        if(usedGpios & GpioPinMask(gamepad->DataGpio)) {
+            fprintf(stderr, "Gamepad %u %s %u is already in use\n", gamepad->Id, CFG_GPIO, gamepad->DataGpio);
+            return false;
+        }
+        usedGpios |= GpioPinMask(gamepad->DataGpio);
+    }
+
+    if(config->Realtime.Priority > (unsigned int) sched_get_priority_max(SCHED_FIFO)) {
+        fprintf(stderr, "Realtime %s must be <= %d\n", CFG_PRIORITY, sched_get_priority_max(SCHED_FIFO));
+        return false;
+    }
+
+    if(config->Realtime.Cpu < -1) {
+        fprintf(stderr, "Realtime %s must be >= 0, or -1 for any\n", CFG_CPU);
+        return false;
+    }
+
+    for(unsigned int i = 0; i < config->Chords.Total; i++) {
+        ChordConfig *chord = config->Chords.Chords + i;
+        if(chord->Buttons == 0 || chord->Key <= 0) {
+            fprintf(stderr, "%s %u needs %s and a %s\n", CFG_CHORD, chord->Id, CFG_BUTTONS, CFG_KEY);
+            return false;
+        }
     }
 
     if(config->Buttons.Total == 0) {
@@ -219,13 +539,30 @@ static bool ValidateConfig(SNESDevConfig *const config) {
 
     for(unsigned int i = 0; i < config->Buttons.Total; i++) {
         ButtonConfig *button = config->Buttons.Buttons + i;
-        if(button == NULL || button->DataGpio == 0 || button->Id == 0 || button->Key <= 0) {
+        if(button == NULL || button->DataGpio == 0 || button->DataGpio >= GPIO_BANK_SIZE || button->Id == 0 || button->Key <= 0) {
             fprintf(stderr, "Bad button config\n");
             return false;
         }
+
+        if(usedGpios & GpioPinMask(button->DataGpio)) {
+            fprintf(stderr, "Button %u %s %u is already in use\n", button->Id, CFG_GPIO, button->DataGpio);
+            return false;
+        }
+        usedGpios |= GpioPinMask(button->DataGpio);
+
+        if(button->Samples == 0 || button->Samples > DEBOUNCE_MAX_SAMPLES) {
+            fprintf(stderr, "Button %u %s must be > 0 and <= %u\n", button->Id, CFG_SAMPLES, DEBOUNCE_MAX_SAMPLES);
+            return false;
+        }
+
+        // Edge events are never sampled, so there's nothing to debounce them with.
+        if(config->Buttons.Events && button->Debounce != DEBOUNCE_NONE) {
+            fprintf(stderr, "Button %u %s must be none with %s\n", button->Id, CFG_DEBOUNCE, CFG_EVENTS);
+            return false;
+        }
     }
 
-    if(config->Buttons.PollFrequency == 0) {
+    if(!config->Buttons.Events && config->Buttons.PollFrequency == 0) {
         fprintf(stderr, "Button %s must be > 0\n", CFG_POLL_FREQ);
         return false;
     }
@@ -234,6 +571,7 @@ static bool ValidateConfig(SNESDevConfig *const config) {
 }
 
 static int VerifyGamepadType(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result) {
+    (void) opt;
     GamepadType type = GetGamepadTypeValue(value);
     if(type == 0) {
         cfg_error(cfg, "Gamepad type must be snes or nes");
@@ -245,6 +583,7 @@ static int VerifyGamepadType(cfg_t *cfg, cfg_opt_t *opt, const char *value, void
 }
 
 static int VerifyInputKey(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result) {
+    (void) opt;
     InputKey key = GetInputKeyValue(value);
     if(key == 0) {
         cfg_error(cfg, "Key is not valid");
@@ -255,12 +594,70 @@ static int VerifyInputKey(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *r
     return 0;
 }
 
+static int VerifySyncSource(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result) {
+    (void) opt;
+    SyncSource source = GetSyncSourceValue(value);
+    if(source == 0) {
+        cfg_error(cfg, "Sync source must be none, timer or socket");
+        return -1;
+    }
+    *(long int *)result = source;
+
+    return 0;
+}
+
+static int VerifyDebounceMode(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result) {
+    (void) opt;
+    DebounceMode mode = GetDebounceModeValue(value);
+    if(mode == 0) {
+        cfg_error(cfg, "Debounce must be none, consecutive or integrator");
+        return -1;
+    }
+    *(long int *)result = mode;
+
+    return 0;
+}
+
+// Gamepad button names joined with +, e.g. SELECT+START, in any case.
+static int VerifyChordButtons(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result) {
+    (void) opt;
+    char names[64];
+    if(strlen(value) >= sizeof(names)) {
+        cfg_error(cfg, "Chord buttons are not valid");
+        return -1;
+    }
+
+    for(unsigned int i = 0; i <= strlen(value); i++) {
+        names[i] = (char) toupper((unsigned char) value[i]);
+    }
+
+    long int buttons = 0;
+    char *next = NULL;
+    for(char *name = strtok_r(names, "+", &next); name != NULL; name = strtok_r(NULL, "+", &next)) {
+        GamepadButton button = GetGamepadButtonValue(name);
+        if(button == 0) {
+            cfg_error(cfg, "Chord button %s must be one of B, Y, SELECT, START, UP, DOWN, LEFT, RIGHT, A, X, L or R", name);
+            return -1;
+        }
+        buttons |= button;
+    }
+    *(long int *)result = buttons;
+
+    return 0;
+}
+
 static Arguments ParseArguments(const int argc, char **argv) {
     Arguments arguments;
     arguments.Verbose = 0;
     arguments.RunAsDaemon = false;
     arguments.DebugEnabled = false;
     arguments.PidFile = NULL;
+    arguments.ConfigFile = NULL;
+    arguments.GpioBackend = SNESDEV_GPIO_BACKEND;
+    arguments.SimScript = NULL;
+    arguments.GpioChip = "/dev/gpiochip0";
+    arguments.CaptureFile = NULL;
+    arguments.ReplayFile = NULL;
 
     const struct argp argumentOptions = { options, ParseOption, OPT_USAGE, OPT_HELP, 0, 0, 0 };
     argp_parse (&argumentOptions, argc, argv, 0, 0, &arguments);
@@ -285,12 +682,137 @@ static error_t ParseOption(int key, char *arg, struct argp_state *state) {
         case OPT_DEBUG:
             arguments->DebugEnabled = true;
             break;
+        case OPT_CONFIG:
+            arguments->ConfigFile = arg;
+            break;
+        case OPT_GPIO:
+            arguments->GpioBackend = arg;
+            break;
+        case OPT_SIM_SCRIPT:
+            arguments->SimScript = arg;
+            break;
+        case OPT_GPIO_CHIP:
+            arguments->GpioChip = arg;
+            break;
+        case OPT_CAPTURE:
+            arguments->CaptureFile = arg;
+            break;
+        case OPT_REPLAY:
+            arguments->ReplayFile = arg;
+            break;
         default:
             return ARGP_ERR_UNKNOWN;
     }
     return 0;
 }
 
+static int FindBus(const GamepadsConfig *const config, unsigned int id) {
+    for(unsigned int i = 0; i < config->TotalBuses; i++) {
+        if(config->Buses[i].Id == id) {
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
+
+// Buttons not in the map keep their default event. Directions on the same axis are paired up here, once.
+static bool ParseGamepadMap(cfg_t *const mapSection, GamepadConfig *const gamepad, InputCodes *const keyboard) {
+    memcpy(gamepad->Map, GamepadButtonEvents, sizeof(gamepad->Map));
+    memset(&gamepad->Codes, 0, sizeof(gamepad->Codes));
+
+    for(unsigned int bit = 0; bit < GAMEPAD_BUTTONS; bit++) {
+        const char *button = GetGamepadButtonString((GamepadButton) (1u << bit));
+        const char *target = mapSection != NULL ? cfg_getstr(mapSection, button) : NULL;
+        if(target != NULL && !ParseMapTarget(target, &gamepad->Map[bit])) {
+            fprintf(stderr, "Gamepad %u %s %s must be KEY_, BTN_ or ABS_ followed by - or +\n", gamepad->Id, CFG_MAP, button);
+            return false;
+        }
+    }
+
+    for(unsigned int bit = 0; bit < GAMEPAD_BUTTONS; bit++) {
+        GamepadButtonEvent *event = &gamepad->Map[bit];
+        event->Opposite = 0;
+
+        for(unsigned int other = 0; event->Type == EV_ABS && other < GAMEPAD_BUTTONS; other++) {
+            const GamepadButtonEvent *otherEvent = &gamepad->Map[other];
+            if(other == bit || otherEvent->Type != EV_ABS || otherEvent->Code != event->Code) {
+                continue;
+            }
+
+            if(otherEvent->Pressed == event->Pressed || event->Opposite != 0) {
+                fprintf(stderr, "Gamepad %u %s can only put one button on each end of an axis\n", gamepad->Id, CFG_MAP);
+                return false;
+            }
+            event->Opposite = (uint16_t) (1u << other);
+        }
+
+        AddInputCode(event->Device == INPUT_KEYBOARD ? keyboard : &gamepad->Codes, event->Type, event->Code);
+    }
+
+    return true;
+}
+
+// KEY_ names go on the keyboard device, BTN_ and ABS_ on the gamepad. An axis takes - or + for the end it goes to.
+static bool ParseMapTarget(const char *const target, GamepadButtonEvent *const event) {
+    memset(event, 0, sizeof(GamepadButtonEvent));
+    event->Type = EV_KEY;
+    event->Pressed = 1;
+
+    if(strncmp(target, "KEY_", 4) == 0) {
+        event->Code = (uint16_t) GetInputKeyValue(target + 4);
+        event->Device = INPUT_KEYBOARD;
+        return event->Code != 0;
+    }
+
+    if(strncmp(target, "BTN_", 4) == 0) {
+        event->Code = (uint16_t) GetInputButtonValue(target + 4);
+        return event->Code != 0;
+    }
+
+    const size_t length = strlen(target);
+    if(strncmp(target, "ABS_", 4) != 0 || length < 6 || (target[length - 1] != '-' && target[length - 1] != '+')) {
+        return false;
+    }
+
+    event->Type = EV_ABS;
+    event->Pressed = target[length - 1] == '-' ? DIGITAL_AXIS_HIGH : DIGITAL_AXIS_LOW;
+    event->Released = DIGITAL_AXIS_ORIGIN;
+    for(unsigned int i = 0; i < TotalInputAxiss; i++) {
+        const char *axis = GetInputAxisString(InputAxisValues[i]);
+        if(strlen(axis) == length - 5 && strncmp(axis, target + 4, length - 5) == 0) {
+            event->Code = (uint16_t) InputAxisValues[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Rates are in presses per second, rounded to a whole number of poll frames pressed and as many released.
+static bool ParseGamepadTurbo(cfg_t *const turboSection, GamepadConfig *const gamepad, unsigned int pollFrequency) {
+    gamepad->TurboMask = 0;
+    memset(gamepad->TurboFrames, 0, sizeof(gamepad->TurboFrames));
+
+    for(unsigned int bit = 0; turboSection != NULL && bit < GAMEPAD_BUTTONS; bit++) {
+        const char *button = GetGamepadButtonString((GamepadButton) (1u << bit));
+        const unsigned int rate = SafeToUnsigned(cfg_getint(turboSection, button));
+        if(rate == 0) {
+            continue;
+        }
+
+        if(rate * 2 > pollFrequency) {
+            fprintf(stderr, "Gamepad %u %s %s must be <= half the %s\n", gamepad->Id, CFG_TURBO, button, CFG_POLL_FREQ);
+            return false;
+        }
+
+        gamepad->TurboMask |= (uint16_t) (1u << bit);
+        gamepad->TurboFrames[bit] = (uint16_t) ((pollFrequency + rate) / (rate * 2));
+    }
+
+    return true;
+}
+
 static inline unsigned int SafeToUnsigned(long x) {
     return x < 0 ? 0 : (unsigned int)x;
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include "gamepad.h"
 #include "uinput.h"
 #include "button.h"
+#include "chord.h"
+#include "GPIO.h"
+#include "realtime.h"
+#include "frameclock.h"
 
 typedef struct {
     unsigned int Verbose;
@@ -12,9 +16,17 @@ typedef struct {
     bool DebugEnabled;
     const char *PidFile;
     int PidFilePointer;
+    const char *CaptureFile;
+    const char *ReplayFile;
+    GpioConfig Gpio;
     GamepadsConfig Gamepads;
     ButtonsConfig Buttons;
+    ChordsConfig Chords;
+    RealtimeConfig Realtime;
+    SyncConfig Sync;
+    InputCodes Keyboard; // Sent on the keyboard device, by buttons and gamepad maps
 } SNESDevConfig;
 
 
-bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNESDevConfig *config);
\ No newline at end of file
+bool TryGetSNESDevConfig(const char *fileName, const int argc, char **argv, SNESDevConfig *config);
+void FreeSNESDevConfig(SNESDevConfig *config);
\ No newline at end of file
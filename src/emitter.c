@@ -0,0 +1,206 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syslog.h>
+
+#include "emitter.h"
+#include "realtime.h"
+#include "scheduler.h"
+
+static void *RunEmitter(void *argument);
+static void EmitGamepadEvent(Emitter *emitter, const GamepadEvent *event);
+static void ReleaseKeyboardKeys(Emitter *emitter, const GamepadConfig *gamepadConfig, uint16_t state);
+static DigitalAxisValue GetAxis(uint16_t state, uint16_t high, uint16_t low);
+
+bool OpenEmitter(Emitter *const emitter, const GamepadsConfig *const config, const Gamepad *const gamepads,
+                 InputDevice *const devices, const InputDevice *const keyboard, Stats *const stats, unsigned int verbose) {
+    memset(emitter, 0, sizeof(Emitter));
+    emitter->Config = config;
+    emitter->Devices = devices;
+    emitter->Keyboard.File = keyboard->File;
+    strcpy(emitter->Keyboard.Name, keyboard->Name);
+    emitter->Stats = stats;
+    emitter->Verbose = verbose;
+    emitter->Opened = calloc(config->Total, sizeof(bool));
+    emitter->Emitted = calloc(config->Total, sizeof(uint16_t));
+    if(emitter->Opened == NULL || emitter->Emitted == NULL || sem_init(&emitter->Ready, 0, 0) < 0) {
+        fprintf(stderr, "Unable to set up the emitter\n");
+        free(emitter->Opened);
+        free(emitter->Emitted);
+        return false;
+    }
+
+    for(unsigned int i = 0; i < config->Total; i++) {
+        emitter->Opened[i] = gamepads[i].Connected;
+    }
+
+    return true;
+}
+
+bool StartEmitter(Emitter *const emitter) {
+    // A realtime sampler keeps the cpu over the emitter, anything else shares it as normal.
+    int error = StartThread(&emitter->Thread, THREAD_PRIORITY_BELOW, RunEmitter, emitter);
+
+    if(error != 0) {
+        fprintf(stderr, "Unable to start the emitter: %s\n", strerror(error));
+        return false;
+    }
+
+    return true;
+}
+
+void StopEmitter(Emitter *const emitter) {
+    __atomic_store_n(&emitter->Stopping, true, __ATOMIC_RELEASE);
+    sem_post(&emitter->Ready);
+    pthread_join(emitter->Thread, NULL);
+}
+
+void CloseEmitter(Emitter *const emitter) {
+    sem_destroy(&emitter->Ready);
+    free(emitter->Opened);
+    free(emitter->Emitted);
+}
+
+void WakeEmitter(Emitter *const emitter) {
+    sem_post(&emitter->Ready);
+}
+
+void DrainEmitter(Emitter *const emitter) {
+    GamepadEventRing *ring = &emitter->Ring;
+
+    unsigned int tail = ring->Tail;
+    const unsigned int head = __atomic_load_n(&ring->Head, __ATOMIC_ACQUIRE);
+    while(tail != head) {
+        EmitGamepadEvent(emitter, &ring->Events[tail & (EMITTER_RING_SIZE - 1)]);
+        tail++;
+        __atomic_store_n(&ring->Tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void *RunEmitter(void *argument) {
+    Emitter *emitter = argument;
+
+    for(;;) {
+        while(sem_wait(&emitter->Ready) < 0 && errno == EINTR);
+
+        // Checked before draining, so whatever was pushed before stopping still gets sent.
+        const bool stopping = __atomic_load_n(&emitter->Stopping, __ATOMIC_ACQUIRE);
+        DrainEmitter(emitter);
+
+        if(stopping) {
+            return NULL;
+        }
+    }
+}
+
+static void EmitGamepadEvent(Emitter *const emitter, const GamepadEvent *const event) {
+    const unsigned int i = event->Gamepad;
+    const GamepadConfig *gamepadConfig = &emitter->Config->Gamepads[i];
+    const unsigned int id = gamepadConfig->Id;
+    InputDevice *device = &emitter->Devices[i];
+
+    // A new input device starts with nothing pressed, so whatever is held gets sent to it.
+    // The keyboard outlives it though, so keys mapped there are let go of first.
+    if(event->Connected != emitter->Opened[i]) {
+        emitter->Opened[i] = event->Connected;
+        if(event->Connected) {
+            syslog(LOG_INFO, "Gamepad%u connected", id);
+            if(HasInputCodes(&gamepadConfig->Codes)) {
+                OpenInputDevice(device, &gamepadConfig->Codes);
+            }
+        } else {
+            syslog(LOG_INFO, "Gamepad%u disconnected", id);
+            ReleaseKeyboardKeys(emitter, gamepadConfig, emitter->Emitted[i]);
+            CloseInputDevice(device);
+        }
+        emitter->Emitted[i] = 0;
+
+        if(!event->Connected) {
+            return;
+        }
+    }
+
+    const uint16_t state = event->State;
+    const uint16_t changed = state ^ emitter->Emitted[i];
+    if(!event->Connected || changed == 0) {
+        return;
+    }
+
+    if(emitter->Verbose > 0) {
+        if(emitter->Verbose > 1) {
+            printf("[%u] State 0x%4x, ", i + 1, state);
+        } else {
+            printf("[%u] ", i + 1);
+        }
+        printf("A: %d, B: %d, X: %d, Y: %d, L: %d, R: %d, Select: %d, Start: %d, XAxis: %u, YAxis: %u\n",
+               (state & GAMEPAD_BUTTON_A) != 0, (state & GAMEPAD_BUTTON_B) != 0,
+               (state & GAMEPAD_BUTTON_X) != 0, (state & GAMEPAD_BUTTON_Y) != 0,
+               (state & GAMEPAD_BUTTON_L) != 0, (state & GAMEPAD_BUTTON_R) != 0,
+               (state & GAMEPAD_BUTTON_SELECT) != 0, (state & GAMEPAD_BUTTON_START) != 0,
+               GetAxis(state, GAMEPAD_BUTTON_LEFT, GAMEPAD_BUTTON_RIGHT), GetAxis(state, GAMEPAD_BUTTON_UP, GAMEPAD_BUTTON_DOWN));
+    }
+
+    // Only send the buttons that changed, in one write per device. Both directions of an axis make one event.
+    const GamepadButtonEvent *map = gamepadConfig->Map;
+    uint16_t remaining = changed;
+    while(remaining != 0) {
+        const unsigned int bit = (unsigned int) __builtin_ctz(remaining);
+        const GamepadButtonEvent *button = &map[bit];
+        remaining &= (uint16_t) ~((1u << bit) | button->Opposite);
+
+        const int value = (state & (1u << bit)) ? button->Pressed
+                          : (state & button->Opposite) ? map[__builtin_ctz(button->Opposite)].Pressed
+                          : button->Released;
+        QueueEvent(button->Device == INPUT_KEYBOARD ? &emitter->Keyboard : device, button->Type, button->Code, value);
+    }
+    FlushInputDevice(device);
+    FlushInputDevice(&emitter->Keyboard);
+
+    emitter->Emitted[i] = state;
+    RecordSharedStat(emitter->Stats, STAT_EMIT, MonotonicNanos() - event->Time);
+}
+
+static void ReleaseKeyboardKeys(Emitter *const emitter, const GamepadConfig *const gamepadConfig, uint16_t state) {
+    for(uint16_t remaining = state; remaining != 0; remaining &= (uint16_t) (remaining - 1)) {
+        const GamepadButtonEvent *button = &gamepadConfig->Map[__builtin_ctz(remaining)];
+        if(button->Device == INPUT_KEYBOARD) {
+            QueueEvent(&emitter->Keyboard, button->Type, button->Code, button->Released);
+        }
+    }
+    FlushInputDevice(&emitter->Keyboard);
+}
+
+static DigitalAxisValue GetAxis(uint16_t state, uint16_t high, uint16_t low) {
+    // ReadGamepads only ever takes valid frames, so opposite directions are never both set.
+    return (state & high) ? DIGITAL_AXIS_HIGH
+                          : (state & low) ? DIGITAL_AXIS_LOW
+                                          : DIGITAL_AXIS_ORIGIN;
+}
@@ -0,0 +1,93 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gamepad.h"
+#include "stats.h"
+#include "uinput.h"
+
+// Power of two, so the free running indices wrap with a mask.
+#define EMITTER_RING_SIZE 64
+
+// What a gamepad looked like when it was sampled. The emitter works out what to send from the last one it saw,
+// so a snapshot that didn't fit only costs the changes it alone carried.
+typedef struct {
+    uint64_t Time; // Latched
+    unsigned int Gamepad; // Index into the gamepads
+    bool Connected;
+    uint16_t State;
+} GamepadEvent;
+
+// Single producer, single consumer: only the sampler moves Head and only the emitter moves Tail.
+typedef struct {
+    unsigned int Head;
+    unsigned int Tail;
+    GamepadEvent Events[EMITTER_RING_SIZE];
+} GamepadEventRing;
+
+// Drains sampled gamepad states into their uinput devices on its own thread, so a slow write never holds up a latch.
+typedef struct {
+    pthread_t Thread;
+    sem_t Ready;
+    bool Stopping;
+    GamepadEventRing Ring;
+    const GamepadsConfig *Config;
+    InputDevice *Devices;
+    InputDevice Keyboard; // Own queue on the keyboard device's file, uinput takes each write whole
+    bool *Opened; // Per gamepad, whether the emitter has its device open
+    uint16_t *Emitted; // Per gamepad, the state last sent to its device
+    Stats *Stats; // Shared with the sampler, only STAT_EMIT is recorded here
+    unsigned int Verbose;
+} Emitter;
+
+// Devices of the gamepads already connected are taken as open.
+bool OpenEmitter(Emitter *emitter, const GamepadsConfig *config, const Gamepad *gamepads, InputDevice *devices,
+                 const InputDevice *keyboard, Stats *stats, unsigned int verbose);
+bool StartEmitter(Emitter *emitter);
+void WakeEmitter(Emitter *emitter);
+void DrainEmitter(Emitter *emitter);
+void StopEmitter(Emitter *emitter);
+void CloseEmitter(Emitter *emitter);
+
+// Called from the sampler only. False when the ring is full, nothing is written and the emitter isn't woken.
+static inline bool PushGamepadEvent(Emitter *const emitter, const GamepadEvent *const event) {
+    GamepadEventRing *ring = &emitter->Ring;
+    const unsigned int head = ring->Head;
+    if(head - __atomic_load_n(&ring->Tail, __ATOMIC_ACQUIRE) == EMITTER_RING_SIZE) {
+        return false;
+    }
+
+    ring->Events[head & (EMITTER_RING_SIZE - 1)] = *event;
+    __atomic_store_n(&ring->Head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
@@ -0,0 +1,280 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <errno.h>
+#include <grp.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "frameclock.h"
+#include "scheduler.h"
+
+// Loop gains as divisors of the phase error: the phase takes half of it each tick and the period a sixteenth,
+// which is critically damped and settles in a handful of frames.
+#define FRAME_CLOCK_PHASE_GAIN 2
+#define FRAME_CLOCK_PERIOD_GAIN 16
+
+// A tick this many periods late means the frontend stalled, start again rather than slewing back.
+#define FRAME_CLOCK_RELOCK_PERIODS 4
+
+DEFINE_ENUM(SyncSource, ENUM_SYNC_SOURCE, unsigned int)
+
+static int OpenTickTimer(uint64_t period);
+static int OpenTickSocket(const char *path, const char *group);
+static uint64_t GetTickArrival(const struct msghdr *message);
+static void UpdateFrameClock(FrameClock *clock, uint64_t tick);
+
+bool OpenFrameClock(FrameClock *const clock, const SyncConfig *const config, unsigned int frequency) {
+    memset(clock, 0, sizeof(FrameClock));
+    clock->File = -1;
+    clock->Source = config->Source;
+    clock->Socket = config->Socket;
+
+    // Until ticks come in, assume they will at the gamepad poll frequency.
+    clock->Period = NANOS_PER_SECOND / frequency;
+    clock->Next = MonotonicNanos() + clock->Period;
+
+    switch(config->Source) {
+        case SYNC_SOURCE_TIMER:
+            clock->File = OpenTickTimer(clock->Period);
+            break;
+        case SYNC_SOURCE_SOCKET:
+            clock->File = OpenTickSocket(config->Socket, config->SocketGroup);
+            break;
+        default:
+            return true;
+    }
+
+    return clock->File >= 0;
+}
+
+void CloseFrameClock(FrameClock *const clock) {
+    if(clock->File < 0) {
+        return;
+    }
+
+    close(clock->File);
+    if(clock->Source == SYNC_SOURCE_SOCKET) {
+        unlink(clock->Socket);
+    }
+}
+
+bool ReadFrameClock(FrameClock *const clock) {
+    uint64_t ticks = 0;
+    uint64_t arrival = 0;
+
+    if(clock->Source == SYNC_SOURCE_TIMER) {
+        if(read(clock->File, &ticks, sizeof(ticks)) != sizeof(ticks)) {
+            ticks = 0;
+        }
+    } else {
+        // Any datagram is a tick, if a few queued up we only care when the latest one arrived.
+        char buffer[16];
+        union {
+            char Buffer[CMSG_SPACE(sizeof(struct timespec))];
+            struct cmsghdr Align;
+        } control;
+        struct iovec vector = { .iov_base = buffer, .iov_len = sizeof(buffer) };
+        struct msghdr message;
+        for(;;) {
+            memset(&message, 0, sizeof(message));
+            message.msg_iov = &vector;
+            message.msg_iovlen = 1;
+            message.msg_control = control.Buffer;
+            message.msg_controllen = sizeof(control.Buffer);
+            if(recvmsg(clock->File, &message, MSG_DONTWAIT) < 0) {
+                break;
+            }
+            ticks++;
+            arrival = GetTickArrival(&message);
+        }
+    }
+
+    if(ticks == 0) {
+        return false;
+    }
+
+    UpdateFrameClock(clock, arrival != 0 ? arrival : MonotonicNanos());
+    return true;
+}
+
+uint64_t GetFrameClockLatch(FrameClock *const clock, uint64_t advance) {
+    // The first predicted frame we haven't latched for yet. Predictions move a little with every tick,
+    // so anything within half a period of the last one is the same frame.
+    uint64_t target = clock->Next;
+    while(target < clock->Sampled + clock->Period / 2) {
+        target += clock->Period;
+    }
+
+    clock->Target = target;
+    return target > advance ? target - advance : 0;
+}
+
+// The kernel stamps datagrams as they arrive, so however late we get round to reading them doesn't end up as
+// phase error. The stamp is realtime, it's moved onto the monotonic clock by the two clocks' current offset.
+static uint64_t GetTickArrival(const struct msghdr *const message) {
+    for(const struct cmsghdr *control = CMSG_FIRSTHDR(message); control != NULL;
+        control = CMSG_NXTHDR((struct msghdr *) message, (struct cmsghdr *) control)) {
+        if(control->cmsg_level != SOL_SOCKET || control->cmsg_type != SCM_TIMESTAMPNS) {
+            continue;
+        }
+
+        struct timespec stamp;
+        memcpy(&stamp, CMSG_DATA(control), sizeof(stamp));
+        struct timespec realtime;
+        clock_gettime(CLOCK_REALTIME, &realtime);
+        uint64_t now = MonotonicNanos();
+
+        int64_t age = (int64_t) (realtime.tv_sec - stamp.tv_sec) * (int64_t) NANOS_PER_SECOND
+            + (realtime.tv_nsec - stamp.tv_nsec);
+        // A step of the realtime clock in between would put it in the future or before we started.
+        if(age < 0 || (uint64_t) age >= now) {
+            return now;
+        }
+        return now - (uint64_t) age;
+    }
+
+    return 0;
+}
+
+static void UpdateFrameClock(FrameClock *const clock, uint64_t tick) {
+    const int64_t period = (int64_t) clock->Period;
+    int64_t error = (int64_t) (tick - clock->Next);
+
+    clock->Ticks++;
+    if(clock->Ticks == 1 || error > FRAME_CLOCK_RELOCK_PERIODS * period || error < -period) {
+        // First tick or the frontend stalled, start from here with the period we had.
+        clock->Ticks = 1;
+        clock->Error = 0;
+        clock->Locked = false;
+        clock->Next = tick + clock->Period;
+    } else if(clock->Ticks == 2) {
+        // Measure the period off the first pair of ticks, then track it.
+        clock->Period = tick - clock->LastTick;
+        clock->Error = 0;
+        clock->Next = tick + clock->Period;
+    } else {
+        // Dropped ticks land on a later predicted frame.
+        if(error > period / 2) {
+            clock->Next += (uint64_t) ((error + period / 2) / period) * clock->Period;
+            error = (int64_t) (tick - clock->Next);
+        }
+
+        clock->Error = error;
+        clock->Period = (uint64_t) (period + error / FRAME_CLOCK_PERIOD_GAIN);
+        clock->Next += (uint64_t) (error / FRAME_CLOCK_PHASE_GAIN) + clock->Period;
+        clock->Locked = error < period / 16 && error > -period / 16;
+    }
+
+    clock->LastTick = tick;
+}
+
+static int OpenTickTimer(uint64_t period) {
+    int file = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if(file < 0) {
+        fprintf(stderr, "Unable to create frame timer\n");
+        return -1;
+    }
+
+    struct itimerspec timer;
+    timer.it_value.tv_sec = timer.it_interval.tv_sec = (time_t) (period / NANOS_PER_SECOND);
+    timer.it_value.tv_nsec = timer.it_interval.tv_nsec = (long) (period % NANOS_PER_SECOND);
+    if(timerfd_settime(file, 0, &timer, NULL) < 0) {
+        fprintf(stderr, "Unable to start frame timer\n");
+        close(file);
+        return -1;
+    }
+
+    return file;
+}
+
+static int OpenTickSocket(const char *const path, const char *const group) {
+    int file = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(file < 0) {
+        fprintf(stderr, "Unable to create frame socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    // Only a socket left over from an earlier run is ours to replace, anything else at the path is a mistake.
+    struct stat status;
+    if(lstat(path, &status) == 0) {
+        if(!S_ISSOCK(status.st_mode)) {
+            fprintf(stderr, "Frame socket %s exists and isn't a socket\n", path);
+            close(file);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    if(bind(file, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        fprintf(stderr, "Unable to bind frame socket %s: %s\n", path, strerror(errno));
+        close(file);
+        return -1;
+    }
+
+    const int on = 1;
+    if(setsockopt(file, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+        fprintf(stderr, "Unable to timestamp frame socket %s, ticks are timed as they're read: %s\n", path, strerror(errno));
+    }
+
+    // The frontend poking it rarely runs as the same user as us, it's let in through the socket's group.
+    bool success = true;
+    if(group[0] != '\0') {
+        const struct group *entry = getgrnam(group);
+        if(entry == NULL) {
+            fprintf(stderr, "Frame socket group %s doesn't exist\n", group);
+            success = false;
+        } else if(chown(path, (uid_t) -1, entry->gr_gid) < 0) {
+            fprintf(stderr, "Unable to give frame socket %s to group %s: %s\n", path, group, strerror(errno));
+            success = false;
+        }
+    }
+
+    if(success && chmod(path, 0660) < 0) {
+        fprintf(stderr, "Unable to set the mode of frame socket %s: %s\n", path, strerror(errno));
+        success = false;
+    }
+
+    if(!success) {
+        close(file);
+        unlink(path);
+        return -1;
+    }
+
+    return file;
+}
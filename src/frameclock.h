@@ -0,0 +1,70 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "enum.h"
+
+#define SYNC_SOCKET_LENGTH 108
+#define SYNC_GROUP_LENGTH 32
+
+#define ENUM_SYNC_SOURCE(XX) \
+    XX(SYNC_SOURCE_NONE, =1, none) \
+    XX(SYNC_SOURCE_TIMER, =2, timer) \
+    XX(SYNC_SOURCE_SOCKET, =3, socket)
+
+DECLARE_ENUM(SyncSource, ENUM_SYNC_SOURCE)
+
+typedef struct {
+    SyncSource Source;
+    char Socket[SYNC_SOCKET_LENGTH];
+    char SocketGroup[SYNC_GROUP_LENGTH]; // Allowed to send ticks along with us, empty for only our own group
+    unsigned int LatchAdvance; // us
+} SyncConfig;
+
+// Follows the period and phase of an external frame tick with a PLL, so gamepads can be latched just before
+// the next frame starts rather than at some unrelated point in it.
+typedef struct {
+    int File;
+    SyncSource Source;
+    const char *Socket;
+    uint64_t Period;
+    uint64_t Next; // Predicted start of the next frame
+    uint64_t LastTick;
+    uint64_t Ticks;
+    uint64_t Target; // Frame start the latch is armed for
+    uint64_t Sampled; // Frame start the last latch was armed for
+    int64_t Error; // Phase error of the last tick
+    bool Locked;
+} FrameClock;
+
+bool OpenFrameClock(FrameClock *clock, const SyncConfig *config, unsigned int frequency);
+void CloseFrameClock(FrameClock *clock);
+bool ReadFrameClock(FrameClock *clock);
+uint64_t GetFrameClockLatch(FrameClock *clock, uint64_t advance);
@@ -32,95 +32,256 @@
 #include "gamepad.h"
 #include "GPIO.h"
 
-#define SNES_CLOCK 12
+// Button bits, then the whole shift register. A SNES pad always reads its last four bits high, and once every bit
+// is out the grounded serial input reads low, where a line with nothing plugged in just reads its pull-up.
+#define SNES_CLOCK GAMEPAD_BUTTONS
 #define NES_CLOCK 8
+#define SNES_BITS 16
+#define NES_BITS 8
+#define SNES_SIGNATURE_MASK 0x1F000
+#define NES_SIGNATURE_MASK 0x100
 
 DEFINE_ENUM(GamepadType, ENUM_GAMEPAD_TYPE, unsigned int)
 DEFINE_ENUM(GamepadButton, ENUM_GAMEPAD_BUTTON, unsigned int)
 
+#define GAMEPAD_BUTTON_EVENT(name, assign, prettyName) [__builtin_ctz(name)] = { GAMEPAD_EVENT_ ## prettyName },
+const GamepadButtonEvent GamepadButtonEvents[GAMEPAD_BUTTONS] = { ENUM_GAMEPAD_BUTTON(GAMEPAD_BUTTON_EVENT) };
+
+static void PulseBuses(const GamepadsConfig *config, uint32_t latchMask, uint32_t clockMask, unsigned int clockPulses,
+                       uint32_t *levels);
+static void ReadBuses(const GamepadsConfig *config, uint32_t latchMask, uint32_t clockMask, unsigned int clockPulses,
+                      uint32_t *levels, GamepadTape *tape);
+static bool TakeGamepadFrame(Gamepad *gamepad, const uint32_t *levels);
+static uint32_t ReadLevelsVoted(unsigned int samples);
+
 bool OpenGamepadControlPins(GamepadsConfig *const config) {
-    bool success = GpioOpen(config->LatchGpio, GPIO_OUTPUT) && GpioOpen(config->ClockGpio, GPIO_OUTPUT);
-    GpioWrite(config->ClockGpio, GPIO_HIGH);
+    bool success = true;
+    config->ClockPulses = 0;
+    config->ClockMask = 0;
+    config->LatchMask = 0;
+
+    for(unsigned int i = 0; i < config->TotalBuses; i++) {
+        GamepadBusConfig *bus = config->Buses + i;
+        success = GpioOpen(bus->LatchGpio, GPIO_OUTPUT) && GpioOpen(bus->ClockGpio, GPIO_OUTPUT) && success;
+
+        // Detecting presence reads one past the end of the shift register.
+        switch (bus->Type) {
+            case GAMEPAD_NES:
+                bus->ClockPulses = config->DetectPresence ? NES_BITS + 1 : NES_CLOCK;
+                break;
+            case GAMEPAD_SNES:
+                bus->ClockPulses = config->DetectPresence ? SNES_BITS + 1 : SNES_CLOCK;
+                break;
+        }
 
-    switch (config->Type) {
-        case GAMEPAD_NES:
-            config->ClockPulses = NES_CLOCK;
-            break;
-        case GAMEPAD_SNES:
-            config->ClockPulses = SNES_CLOCK;
-            break;
+        // Shorter buses are clocked along with the rest, their gamepads just ignore the extra bits.
+        if(bus->ClockPulses > config->ClockPulses) {
+            config->ClockPulses = bus->ClockPulses;
+        }
+        config->ClockMask |= GpioPinMask(bus->ClockGpio);
+        config->LatchMask |= GpioPinMask(bus->LatchGpio);
     }
 
+    GpioWriteMask(config->ClockMask, GPIO_HIGH);
+
     return success;
 }
 
-bool OpenGamepad(Gamepad *const gamepad) {
-    gamepad->XAxis = DIGITAL_AXIS_ORIGIN;
-    gamepad->YAxis = DIGITAL_AXIS_ORIGIN;
+bool OpenGamepad(Gamepad *const gamepad, const GamepadsConfig *const config, const GamepadConfig *const gamepadConfig) {
+    const GamepadBusConfig *bus = config->Buses + gamepadConfig->Bus;
+
+    memset(gamepad, 0, sizeof(Gamepad));
+    gamepad->DataGpio = gamepadConfig->DataGpio;
+    gamepad->ClockPulses = bus->ClockPulses;
+    gamepad->LatchMask = GpioPinMask(bus->LatchGpio);
+    gamepad->ClockMask = GpioPinMask(bus->ClockGpio);
+
+    if (bus->Type == GAMEPAD_NES) {
+        gamepad->ButtonMask = (1 << NES_CLOCK) - 1;
+        gamepad->SignatureMask = config->DetectPresence ? NES_SIGNATURE_MASK : 0;
+    } else {
+        gamepad->ButtonMask = (1 << SNES_CLOCK) - 1;
+        gamepad->SignatureMask = config->DetectPresence ? SNES_SIGNATURE_MASK : 0;
+    }
+
+    // Read bits are set for low levels, so only the serial input past the end is.
+    gamepad->Signature = gamepad->SignatureMask & ~(gamepad->SignatureMask >> 1);
+
+    // Without presence detection every gamepad is always there.
+    gamepad->Present = gamepad->Connected = !config->DetectPresence;
+
     return GpioOpen(gamepad->DataGpio, GPIO_INPUT);
 }
 
-void ReadGamepads(Gamepad *const gamepads, GamepadsConfig *const config) {
+void ReadGamepads(Gamepad *const gamepads, GamepadsConfig *const config, GamepadTape *const tape) {
+    uint32_t levels[SNES_BITS + 1];
+    if(tape != NULL) {
+        tape->Played = 0;
+        tape->Trains = tape->Playing ? tape->Trains : 0;
+    }
+    ReadBuses(config, config->LatchMask, config->ClockMask, config->ClockPulses, levels, tape);
 
+    // A connected gamepad with a bad frame has its bus read again straight away, rather than waiting a whole poll.
+    // One that's missing its signature is most likely unplugged, that's left to CheckGamepadPresence to count.
+    uint32_t latchMask = 0, clockMask = 0;
+    unsigned int clockPulses = 0;
     Gamepad *gamepad;
     for(unsigned int i = 0; i < config->Total; i++) {
         gamepad = gamepads + i;
-        gamepad->LastState = gamepad->State;
-        gamepad->State = 0;
+        gamepad->Retrying = !TakeGamepadFrame(gamepad, levels) && gamepad->Present && gamepad->Connected;
+        if(gamepad->Retrying) {
+            latchMask |= gamepad->LatchMask;
+            clockMask |= gamepad->ClockMask;
+            clockPulses = gamepad->ClockPulses > clockPulses ? gamepad->ClockPulses : clockPulses;
+        }
     }
 
-    // Latch the shift register.
-    GpioPulseHigh(config->LatchGpio, 12, 6);
+    for(unsigned int retry = 0; retry < config->Retries && latchMask != 0; retry++) {
+        ReadBuses(config, latchMask, clockMask, clockPulses, levels, tape);
 
-    for (unsigned int clock = 0; clock < config->ClockPulses; clock++) {
+        latchMask = clockMask = 0;
         for(unsigned int i = 0; i < config->Total; i++) {
             gamepad = gamepads + i;
+            if(!gamepad->Retrying) {
+                continue;
+            }
 
-            // SNES sets gpio low when button pressed.
-            // Must have a pull-up resistor or we'll get all buttons pressed when controller disconnected.
-            if (GpioRead(gamepad->DataGpio) == GPIO_LOW) {
-                gamepad->State |= (1 << clock);
+            gamepad->Rereads++;
+            gamepad->Retrying = !TakeGamepadFrame(gamepad, levels) && gamepad->Present;
+            if(gamepad->Retrying) {
+                latchMask |= gamepad->LatchMask;
+                clockMask |= gamepad->ClockMask;
             }
         }
+    }
 
-        // Pulse the clock to shift the register
-        GpioPulseLow(config->ClockGpio, 6, 6);
+    // Out of retries, these keep their last good state.
+    for(unsigned int i = 0; i < config->Total; i++) {
+        gamepad = gamepads + i;
+        if(gamepad->Retrying) {
+            gamepad->Errors++;
+            gamepad->Retrying = false;
+        }
     }
 }
 
-bool CheckGamepadState(Gamepad *const gamepad) {
-    if(gamepad->LastState == gamepad->State) {
+bool CheckGamepadPresence(Gamepad *const gamepad, const GamepadsConfig *const config) {
+    if(gamepad->Present == gamepad->Connected) {
+        gamepad->PresenceFrames = 0;
         return false;
     }
 
-    gamepad->B = (gamepad->State & GAMEPAD_BUTTON_B) != 0;
-    gamepad->Y = (gamepad->State & GAMEPAD_BUTTON_Y) != 0;
-    gamepad->Select = (gamepad->State & GAMEPAD_BUTTON_SELECT) != 0;
-    gamepad->Start = (gamepad->State & GAMEPAD_BUTTON_START) != 0;
+    // Only believe a plug or unplug once it's been seen for enough reads in a row.
+    gamepad->PresenceFrames++;
+    if(gamepad->PresenceFrames < (gamepad->Connected ? config->DisconnectFrames : config->ConnectFrames)) {
+        return false;
+    }
 
-    bool up = (gamepad->State & GAMEPAD_BUTTON_UP) != 0;
-    bool down = (gamepad->State & GAMEPAD_BUTTON_DOWN) != 0;
-    bool left = (gamepad->State & GAMEPAD_BUTTON_LEFT) != 0;
-    bool right = (gamepad->State & GAMEPAD_BUTTON_RIGHT) != 0;
+    gamepad->Connected = gamepad->Present;
+    gamepad->PresenceFrames = 0;
+    if(!gamepad->Connected) {
+        gamepad->State = 0;
+    }
 
-    gamepad->YAxis = up ? DIGITAL_AXIS_HIGH
-                        : down ? DIGITAL_AXIS_LOW
-                        : DIGITAL_AXIS_ORIGIN;
+    return true;
+}
 
-    gamepad->XAxis = left ? DIGITAL_AXIS_HIGH
-                        : right ? DIGITAL_AXIS_LOW
-                        : DIGITAL_AXIS_ORIGIN;
+// Reads back to back for long enough to connect whatever is plugged in, rather than waiting on the poll.
+void ProbeGamepads(Gamepad *const gamepads, GamepadsConfig *const config) {
+    const unsigned int frames = config->ConnectFrames > 0 ? config->ConnectFrames : 1;
+    for(unsigned int frame = 0; frame < frames; frame++) {
+        ReadGamepads(gamepads, config, NULL);
+        for(unsigned int i = 0; i < config->Total; i++) {
+            CheckGamepadPresence(gamepads + i, config);
+        }
+    }
+}
 
-    gamepad->A = (gamepad->State & GAMEPAD_BUTTON_A) != 0;
-    gamepad->X = (gamepad->State & GAMEPAD_BUTTON_X) != 0;
-    gamepad->L = (gamepad->State & GAMEPAD_BUTTON_L) != 0;
-    gamepad->R = (gamepad->State & GAMEPAD_BUTTON_R) != 0;
+static void PulseBuses(const GamepadsConfig *const config, uint32_t latchMask, uint32_t clockMask, unsigned int clockPulses,
+                       uint32_t *const levels) {
+    GpioBarrier();
 
-    // Check that we don't have noise.
-    if((up && down) || (left && right)) {
-        gamepad->State = 0;
+    // Latch the shift registers on every bus.
+    GpioPulseHighMask(latchMask, config->LatchHigh, config->LatchLow);
+
+    for (unsigned int clock = 0; clock < clockPulses; clock++) {
+        // Snapshot every data line at once, they're split out into gamepads after the pulse train.
+        levels[clock] = ReadLevelsVoted(config->Oversample);
+
+        // Pulse the clocks to shift the registers
+        GpioPulseLowMask(clockMask, config->ClockLow, config->ClockHigh);
+    }
+
+    GpioBarrier();
+}
+
+static void ReadBuses(const GamepadsConfig *const config, uint32_t latchMask, uint32_t clockMask, unsigned int clockPulses,
+                      uint32_t *const levels, GamepadTape *const tape) {
+    if(tape == NULL) {
+        PulseBuses(config, latchMask, clockMask, clockPulses, levels);
+        return;
+    }
+
+    // A train that wasn't recorded reads all high, like an empty socket.
+    uint32_t *train = tape->Levels + (tape->Playing ? tape->Played : tape->Trains) * tape->ClockPulses;
+    if(tape->Playing) {
+        for(unsigned int clock = 0; clock < clockPulses; clock++) {
+            levels[clock] = tape->Played < tape->Trains ? train[clock] : ~(uint32_t) 0;
+        }
+        tape->Played++;
+        return;
+    }
+
+    PulseBuses(config, latchMask, clockMask, clockPulses, levels);
+    if(tape->Trains < tape->MaxTrains) {
+        memcpy(train, levels, clockPulses * sizeof(uint32_t));
+        for(unsigned int clock = clockPulses; clock < tape->ClockPulses; clock++) {
+            train[clock] = ~(uint32_t) 0;
+        }
+        tape->Trains++;
+    }
+}
+
+static bool TakeGamepadFrame(Gamepad *const gamepad, const uint32_t *const levels) {
+    // SNES sets gpio low when button pressed.
+    // Must have a pull-up resistor or we'll get all buttons pressed when controller disconnected.
+    uint32_t bits = 0;
+    const uint32_t dataMask = GpioPinMask(gamepad->DataGpio);
+    for (unsigned int clock = 0; clock < gamepad->ClockPulses; clock++) {
+        if ((levels[clock] & dataMask) == 0) {
+            bits |= (1u << clock);
+        }
+    }
+
+    // A frame is only taken when it looks like a gamepad and no opposite directions are held.
+    // Otherwise the last state is kept, so nothing corrupt is ever sent.
+    gamepad->Present = (bits & gamepad->SignatureMask) == gamepad->Signature;
+    const uint16_t state = (uint16_t) (bits & gamepad->ButtonMask);
+    if (!gamepad->Present
+        || ((state & GAMEPAD_BUTTON_UP) && (state & GAMEPAD_BUTTON_DOWN))
+        || ((state & GAMEPAD_BUTTON_LEFT) && (state & GAMEPAD_BUTTON_RIGHT))) {
         return false;
     }
 
+    gamepad->State = state;
     return true;
-}
\ No newline at end of file
+}
+
+static uint32_t ReadLevelsVoted(unsigned int samples) {
+    if (samples <= 1) {
+        return GpioReadLevels();
+    }
+
+    // Count the high reads of every line at once, each word holds one bit of all the counts.
+    uint32_t ones = 0, twos = 0, fours = 0;
+    for (unsigned int sample = 0; sample < samples; sample++) {
+        const uint32_t levels = GpioReadLevels();
+        const uint32_t carry = ones & levels;
+        ones ^= levels;
+        fours |= twos & carry;
+        twos ^= carry;
+    }
+
+    // High on at least 2 of 3, or 3 of 5.
+    return samples == 3 ? (twos | fours) : (fours | (twos & ones));
+}
@@ -55,39 +55,109 @@
 DECLARE_ENUM(GamepadType, ENUM_GAMEPAD_TYPE)
 DECLARE_ENUM(GamepadButton, ENUM_GAMEPAD_BUTTON)
 
+// The default input event of each button in ENUM_GAMEPAD_BUTTON, by its name: type, code, pressed and released
+// values, and for a direction the opposite one on the same axis. All of them go on the gamepad device.
+#define GAMEPAD_EVENT_B EV_KEY, BTN_B, 1, 0, 0
+#define GAMEPAD_EVENT_Y EV_KEY, BTN_Y, 1, 0, 0
+#define GAMEPAD_EVENT_SELECT EV_KEY, BTN_SELECT, 1, 0, 0
+#define GAMEPAD_EVENT_START EV_KEY, BTN_START, 1, 0, 0
+#define GAMEPAD_EVENT_UP EV_ABS, ABS_Y, DIGITAL_AXIS_HIGH, DIGITAL_AXIS_ORIGIN, GAMEPAD_BUTTON_DOWN
+#define GAMEPAD_EVENT_DOWN EV_ABS, ABS_Y, DIGITAL_AXIS_LOW, DIGITAL_AXIS_ORIGIN, GAMEPAD_BUTTON_UP
+#define GAMEPAD_EVENT_LEFT EV_ABS, ABS_X, DIGITAL_AXIS_HIGH, DIGITAL_AXIS_ORIGIN, GAMEPAD_BUTTON_RIGHT
+#define GAMEPAD_EVENT_RIGHT EV_ABS, ABS_X, DIGITAL_AXIS_LOW, DIGITAL_AXIS_ORIGIN, GAMEPAD_BUTTON_LEFT
+#define GAMEPAD_EVENT_A EV_KEY, BTN_A, 1, 0, 0
+#define GAMEPAD_EVENT_X EV_KEY, BTN_X, 1, 0, 0
+#define GAMEPAD_EVENT_L EV_KEY, BTN_TL, 1, 0, 0
+#define GAMEPAD_EVENT_R EV_KEY, BTN_TR, 1, 0, 0
+
+#define GAMEPAD_BUTTONS 12
+
 typedef struct {
-    unsigned int Id;
-    uint8_t DataGpio;
-} GamepadConfig;
+    uint16_t Type;
+    uint16_t Code;
+    int32_t Pressed;
+    int32_t Released;
+    uint16_t Opposite; // Mask of the other direction on an axis, whose value wins when this one isn't pressed
+    InputDeviceType Device;
+} GamepadButtonEvent;
 
+// The default map, indexed by bit number in State, generated from ENUM_GAMEPAD_BUTTON.
+extern const GamepadButtonEvent GamepadButtonEvents[GAMEPAD_BUTTONS];
+
+// Gamepads on a bus share its clock and latch, so they're all the same type.
 typedef struct {
-    unsigned int Total;
-    GamepadConfig Gamepads[SNESDEV_MAX_GAMEPADS];
+    unsigned int Id;
     GamepadType Type;
     unsigned int ClockPulses;
     uint8_t ClockGpio;
     uint8_t LatchGpio;
-    unsigned int PollFrequency;
+} GamepadBusConfig;
+
+typedef struct {
+    unsigned int Id;
+    unsigned int Bus; // Index into Buses
+    uint8_t DataGpio;
+    GamepadButtonEvent Map[GAMEPAD_BUTTONS]; // Indexed by bit number in State
+    InputCodes Codes; // Mapped to the gamepad device
+    uint16_t TurboMask; // Buttons that toggle while held
+    uint16_t TurboFrames[GAMEPAD_BUTTONS]; // Poll frames each of them is pressed for and then released for
+} GamepadConfig;
+
+typedef struct {
+    unsigned int Total;
+    GamepadConfig *Gamepads;
+    unsigned int TotalBuses;
+    GamepadBusConfig *Buses;
+    unsigned int ClockPulses; // Most of any bus
+    uint32_t ClockMask; // Every bus is latched and clocked together
+    uint32_t LatchMask;
+    unsigned int Retries; // Re-reads of a bus with a bad frame before it's dropped
+    unsigned int Oversample; // Level reads per clock, the majority wins
+    bool DetectPresence;
+    unsigned int ConnectFrames;
+    unsigned int DisconnectFrames;
+    unsigned int PollFrequency; // Hz
+    unsigned int IdleFrequency; // Hz, 0 always polls at PollFrequency
+    unsigned int IdleTimeout; // s
+    uint32_t LatchHigh; // ns
+    uint32_t LatchLow;
+    uint32_t ClockLow;
+    uint32_t ClockHigh;
 } GamepadsConfig;
 
 typedef struct {
     uint8_t DataGpio;
+    unsigned int ClockPulses;
+    uint32_t LatchMask; // Of the gamepad's bus, to read it again on its own
+    uint32_t ClockMask;
+    uint16_t ButtonMask;
+    uint32_t SignatureMask; // Bits that must read as Signature for a gamepad to be plugged in
+    uint32_t Signature;
+    bool Present; // Signature matched on the last read
+    bool Connected; // Present for long enough, has an input device
+    unsigned int PresenceFrames; // Reads in a row where Present has differed from Connected
+    bool Retrying;
+    uint64_t Rereads; // Reads of the bus again after a bad frame
+    uint64_t Errors; // Frames dropped as still bad once out of retries
     uint16_t State;
-    uint16_t LastState;
-    bool B;
-    bool Y;
-    bool Select;
-    bool Start;
-    DigitalAxisValue YAxis;
-    DigitalAxisValue XAxis;
-    bool A;
-    bool X;
-    bool L;
-    bool R;
+    uint16_t TurboHeld; // Turbo buttons held as of the last frame pushed
+    uint64_t TurboStart[GAMEPAD_BUTTONS]; // Frame each of them was pressed on
 } Gamepad;
 
+// The raw levels of every pulse train in a frame, before any of it is validated: the train of all buses, then one
+// per retry. Recording keeps a copy of each train as it's read, playing takes them in order instead of pulsing the buses.
+typedef struct {
+    uint32_t *Levels; // MaxTrains trains of ClockPulses level words
+    unsigned int MaxTrains; // 1 + Retries
+    unsigned int ClockPulses;
+    unsigned int Trains; // Recorded, or there to be played
+    unsigned int Played;
+    bool Playing;
+} GamepadTape;
+
 bool OpenGamepadControlPins(GamepadsConfig *config);
-bool OpenGamepad(Gamepad *gamepad);
-void ReadGamepads(Gamepad *gamepads, GamepadsConfig *config);
-bool CheckGamepadState(Gamepad *gamepad);
+bool OpenGamepad(Gamepad *gamepad, const GamepadsConfig *config, const GamepadConfig *gamepadConfig);
+void ReadGamepads(Gamepad *gamepads, GamepadsConfig *config, GamepadTape *tape);
+bool CheckGamepadPresence(Gamepad *gamepad, const GamepadsConfig *config);
+void ProbeGamepads(Gamepad *gamepads, GamepadsConfig *config);
 
@@ -0,0 +1,54 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "gpiochip.h"
+#include "SNESDevConfig.h"
+
+int RequestGpioLines(const char *chip, struct gpio_v2_line_request *const request) {
+    int chipFile = open(chip, O_RDONLY | O_CLOEXEC);
+    if (chipFile < 0) {
+        fprintf(stderr, "Unable to open %s\n", chip);
+        return -1;
+    }
+
+    strncpy(request->consumer, LOG_IDENTITY, sizeof(request->consumer) - 1);
+    int result = ioctl(chipFile, GPIO_V2_GET_LINE_IOCTL, request);
+    close(chipFile);
+
+    if (result < 0) {
+        fprintf(stderr, "Unable to request %u lines from %s\n", request->num_lines, chip);
+        return -1;
+    }
+
+    return request->fd;
+}
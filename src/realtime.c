@@ -0,0 +1,122 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syslog.h>
+
+#include "realtime.h"
+
+// Enough for the deepest the poll loop goes, including the per frame arrays on the stack.
+#define PREFAULT_STACK_SIZE (64 * 1024)
+
+// Helper threads only wait and make a few syscalls, the default stack would be locked whole under LockMemory.
+#define THREAD_STACK_SIZE (64 * 1024)
+
+static void PrefaultStack(void);
+
+bool StartRealtime(RealtimeConfig *const config) {
+    bool success = true;
+
+    if(config->LockMemory) {
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            PrefaultStack();
+            syslog(LOG_INFO, "Locked memory");
+        } else {
+            syslog(LOG_WARNING, "Unable to lock memory: %s", strerror(errno));
+            success = false;
+        }
+    }
+
+    if(config->Cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config->Cpu, &cpus);
+        if(sched_setaffinity(0, sizeof(cpus), &cpus) == 0) {
+            syslog(LOG_INFO, "Pinned to cpu %d", config->Cpu);
+        } else {
+            syslog(LOG_WARNING, "Unable to pin to cpu %d: %s", config->Cpu, strerror(errno));
+            success = false;
+        }
+    }
+
+    if(config->Priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = (int) config->Priority;
+        if(sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+            syslog(LOG_INFO, "Running as SCHED_FIFO with priority %u", config->Priority);
+        } else {
+            syslog(LOG_WARNING, "Unable to run as SCHED_FIFO with priority %u: %s", config->Priority, strerror(errno));
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+// Every signal is blocked in helper threads, so they're all delivered to the sampler, the one that checks running.
+int StartThread(pthread_t *const thread, ThreadPriority priority, void *(*run)(void *), void *const data) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, THREAD_STACK_SIZE);
+
+    int policy;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if(priority == THREAD_PRIORITY_NORMAL) {
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, SCHED_OTHER);
+        pthread_attr_setschedparam(&attributes, &param);
+    } else if(priority == THREAD_PRIORITY_BELOW && pthread_getschedparam(pthread_self(), &policy, &param) == 0
+              && policy == SCHED_FIFO && param.sched_priority > 1) {
+        param.sched_priority--;
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+        pthread_attr_setschedparam(&attributes, &param);
+    }
+
+    sigset_t signals, previous;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+    int error = pthread_create(thread, &attributes, run, data);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    pthread_attr_destroy(&attributes);
+
+    return error;
+}
+
+static void PrefaultStack(void) {
+    // Touch every page now so the locked stack doesn't fault in the poll loop.
+    unsigned char stack[PREFAULT_STACK_SIZE];
+    memset(stack, 0, sizeof(stack));
+    __asm__ __volatile__("" : : "r"(stack) : "memory");
+}
@@ -0,0 +1,47 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef struct {
+    unsigned int Priority;
+    bool LockMemory;
+    int Cpu;
+} RealtimeConfig;
+
+// How a helper thread is scheduled next to the sampler.
+typedef enum {
+    THREAD_PRIORITY_INHERIT, // As the caller
+    THREAD_PRIORITY_BELOW, // One below a realtime caller, otherwise as the caller
+    THREAD_PRIORITY_NORMAL // Never realtime, whatever the caller is
+} ThreadPriority;
+
+bool StartRealtime(RealtimeConfig *config);
+int StartThread(pthread_t *thread, ThreadPriority priority, void *(*run)(void *), void *data);
@@ -0,0 +1,143 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include "sampler.h"
+#include "scheduler.h"
+
+static uint16_t GetTurboState(const GamepadConfig *gamepadConfig, Gamepad *gamepad, uint64_t frame);
+
+bool ProcessGamepadFrame(GamepadsConfig *const config, Gamepad *const gamepads, Capture *const capture,
+                         Emitter *const emitter, GamepadEvent *const pushed, Chords *const chords, Stats *const stats,
+                         uint64_t frame) {
+    const uint64_t latched = MonotonicNanos();
+
+    // Read states of the buttons, keeping the levels they came from when capturing.
+    const bool capturing = capture != NULL && capture->Buffers[0] != NULL;
+    ReadGamepads(&gamepads[0], config, capturing ? &capture->Tape : NULL);
+    const uint64_t read = MonotonicNanos();
+
+    for(unsigned int i = 0; i < config->Total; i++) {
+        CheckGamepadPresence(gamepads + i, config);
+    }
+
+    // A capture that can't be written is given up on rather than failing every frame.
+    if(capturing && !WriteCaptureRecord(capture, latched)) {
+        CloseCapture(capture);
+    }
+
+    const bool anyUpdated = PushGamepads(config, gamepads, emitter, pushed, stats, latched, frame);
+    if(chords != NULL) {
+        ProcessChords(chords, gamepads, config->Total, latched);
+    }
+    const uint64_t decoded = MonotonicNanos();
+
+    RecordStat(stats, STAT_READ, read - latched);
+    RecordStat(stats, STAT_DECODE, decoded - read);
+    RecordStat(stats, STAT_FRAME, decoded - latched);
+
+    return anyUpdated;
+}
+
+bool ReplayGamepadFrame(GamepadsConfig *const config, Gamepad *const gamepads, Capture *const replay,
+                        Emitter *const emitter, GamepadEvent *const pushed, Chords *const chords, Stats *const stats,
+                        uint64_t frame) {
+    const uint64_t latched = MonotonicNanos();
+
+    // The recorded levels go through the same checks as levels read off the buses.
+    if(!LoadCaptureRecord(replay)) {
+        return false;
+    }
+
+    ReadGamepads(&gamepads[0], config, &replay->Tape);
+    for(unsigned int i = 0; i < config->Total; i++) {
+        CheckGamepadPresence(gamepads + i, config);
+    }
+
+    const bool anyUpdated = PushGamepads(config, gamepads, emitter, pushed, stats, latched, frame);
+    if(chords != NULL) {
+        ProcessChords(chords, gamepads, config->Total, latched);
+    }
+    RecordStat(stats, STAT_FRAME, MonotonicNanos() - latched);
+
+    return anyUpdated;
+}
+
+bool PushGamepads(GamepadsConfig *const config, Gamepad *const gamepads, Emitter *const emitter,
+                  GamepadEvent *const pushed, Stats *const stats, uint64_t latched, uint64_t frame) {
+    // Hand whatever changed to the emitter, a gamepad that doesn't fit goes again next frame.
+    // What's emitted is tracked apart from State, which stays as read so turbo buttons are seen held throughout.
+    bool anyUpdated = false;
+    bool anyPushed = false;
+    for(unsigned int i = 0; i < config->Total; i++) {
+        Gamepad *gamepad = gamepads + i;
+        const GamepadConfig *gamepadConfig = config->Gamepads + i;
+        const uint16_t state = GetTurboState(gamepadConfig, gamepad, frame);
+
+        // Holding a turbo button keeps the poll rate up, or the toggling would slow down with it.
+        if(gamepad->Connected && (gamepad->State & gamepadConfig->TurboMask)) {
+            anyUpdated = true;
+        }
+
+        if(gamepad->Connected == pushed[i].Connected && state == pushed[i].State) {
+            continue;
+        }
+
+        anyUpdated = true;
+        const GamepadEvent event = { .Time = latched, .Gamepad = i, .Connected = gamepad->Connected, .State = state };
+        if(PushGamepadEvent(emitter, &event)) {
+            pushed[i] = event;
+            anyPushed = true;
+        } else {
+            stats->Overruns++;
+        }
+    }
+
+    if(anyPushed) {
+        WakeEmitter(emitter);
+    }
+
+    return anyUpdated;
+}
+
+// Every turbo button is pressed for its TurboFrames and then released for as many, counted from the frame it was
+// pressed on, so a press always shows straight away, however short it is.
+static uint16_t GetTurboState(const GamepadConfig *const gamepadConfig, Gamepad *const gamepad, uint64_t frame) {
+    const uint16_t held = gamepad->State & gamepadConfig->TurboMask;
+    uint16_t released = 0;
+    for(uint16_t remaining = held; remaining != 0; remaining &= (uint16_t) (remaining - 1)) {
+        const unsigned int bit = (unsigned int) __builtin_ctz(remaining);
+        if(!(gamepad->TurboHeld & (1u << bit))) {
+            gamepad->TurboStart[bit] = frame;
+        }
+        if(((frame - gamepad->TurboStart[bit]) / gamepadConfig->TurboFrames[bit]) & 1) {
+            released |= (uint16_t) (1u << bit);
+        }
+    }
+    gamepad->TurboHeld = held;
+
+    return gamepad->State & (uint16_t) ~released;
+}
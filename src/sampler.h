@@ -0,0 +1,47 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "capture.h"
+#include "chord.h"
+#include "emitter.h"
+#include "gamepad.h"
+#include "stats.h"
+
+// One frame of the poll loop, up to handing the gamepads that changed to the emitter.
+// Each returns whether any gamepad changed or is held on turbo, pushed holds what the emitter was last handed for each
+// gamepad. Turbo buttons toggle on frame, the count of poll frames so far. Chord keys are queued but not flushed.
+bool ProcessGamepadFrame(GamepadsConfig *config, Gamepad *gamepads, Capture *capture, Emitter *emitter, GamepadEvent *pushed,
+                         Chords *chords, Stats *stats, uint64_t frame);
+bool ReplayGamepadFrame(GamepadsConfig *config, Gamepad *gamepads, Capture *replay, Emitter *emitter, GamepadEvent *pushed,
+                        Chords *chords, Stats *stats, uint64_t frame);
+bool PushGamepads(GamepadsConfig *config, Gamepad *gamepads, Emitter *emitter, GamepadEvent *pushed, Stats *stats,
+                  uint64_t latched, uint64_t frame);
@@ -0,0 +1,117 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "scheduler.h"
+
+static inline struct timespec ToTimespec(uint64_t nanos) {
+    struct timespec time = { (time_t) (nanos / NANOS_PER_SECOND), (long) (nanos % NANOS_PER_SECOND) };
+    return time;
+}
+
+bool OpenScheduler(Scheduler *const scheduler, unsigned int frequency) {
+    memset(scheduler, 0, sizeof(Scheduler));
+
+    scheduler->File = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if(scheduler->File < 0) {
+        fprintf(stderr, "Unable to create poll timer\n");
+        return false;
+    }
+
+    if(!SetSchedulerFrequency(scheduler, frequency)) {
+        close(scheduler->File);
+        return false;
+    }
+
+    return true;
+}
+
+bool SetSchedulerFrequency(Scheduler *const scheduler, unsigned int frequency) {
+    // Start a new grid from now, the current frame counts as its first deadline.
+    scheduler->Period = NANOS_PER_SECOND / frequency;
+    scheduler->Start = MonotonicNanos();
+    scheduler->Ticks = 0;
+    scheduler->Deadline = scheduler->Start;
+
+    struct itimerspec timer;
+    timer.it_value = ToTimespec(scheduler->Start + scheduler->Period);
+    timer.it_interval = ToTimespec(scheduler->Period);
+    if(timerfd_settime(scheduler->File, TFD_TIMER_ABSTIME, &timer, NULL) < 0) {
+        fprintf(stderr, "Unable to start poll timer\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool SetSchedulerDeadline(Scheduler *const scheduler, uint64_t deadline) {
+    // Wake once at the deadline, the caller arms the next one. A zero period marks the scheduler as one shot.
+    scheduler->Period = 0;
+    scheduler->Deadline = deadline;
+
+    struct itimerspec timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value = ToTimespec(deadline);
+    if(timerfd_settime(scheduler->File, TFD_TIMER_ABSTIME, &timer, NULL) < 0) {
+        fprintf(stderr, "Unable to start poll timer\n");
+        return false;
+    }
+
+    return true;
+}
+
+void CloseScheduler(Scheduler *const scheduler) {
+    close(scheduler->File);
+}
+
+bool WaitScheduler(Scheduler *const scheduler) {
+    // Expirations counts every deadline since the last wait. We only ever run the latest one,
+    // any before it were missed and skipping them keeps us on the grid rather than bursting to catch up.
+    uint64_t expirations;
+    if(read(scheduler->File, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0) {
+        return false;
+    }
+
+    scheduler->Frames += expirations;
+    scheduler->Missed += expirations - 1;
+    if(scheduler->Period > 0) {
+        scheduler->Ticks += expirations;
+        scheduler->Deadline = scheduler->Start + scheduler->Ticks * scheduler->Period;
+    }
+    return true;
+}
+
+uint64_t MonotonicNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NANOS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
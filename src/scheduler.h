@@ -0,0 +1,51 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NANOS_PER_SECOND 1000000000ULL
+
+// Wakes on a fixed grid of absolute deadlines, so time spent working doesn't push the next frame back.
+typedef struct {
+    int File;
+    uint64_t Period;
+    uint64_t Start;
+    uint64_t Ticks;
+    uint64_t Deadline;
+    uint64_t Frames;
+    uint64_t Missed;
+} Scheduler;
+
+bool OpenScheduler(Scheduler *scheduler, unsigned int frequency);
+bool SetSchedulerFrequency(Scheduler *scheduler, unsigned int frequency);
+bool SetSchedulerDeadline(Scheduler *scheduler, uint64_t deadline);
+void CloseScheduler(Scheduler *scheduler);
+bool WaitScheduler(Scheduler *scheduler);
+uint64_t MonotonicNanos(void);
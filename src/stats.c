@@ -0,0 +1,113 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/syslog.h>
+
+#include "stats.h"
+
+#define STATS_LINE_LENGTH 1024
+
+DEFINE_ENUM(Stat, ENUM_STAT, unsigned int)
+
+static void LoadHistogram(Histogram *to, const Histogram *from);
+static uint64_t Percentile(const Histogram *histogram, unsigned int percent);
+
+void ResetStats(Stats *const stats) {
+    memset(stats, 0, sizeof(Stats));
+}
+
+void LogStats(const Stats *const stats, bool useSyslog) {
+    char line[STATS_LINE_LENGTH];
+
+    snprintf(line, sizeof(line), "Frames: %llu, Missed: %llu, Overruns: %llu, Active: %llums, Idle: %llums",
+             (unsigned long long) stats->Frames, (unsigned long long) stats->Missed, (unsigned long long) stats->Overruns,
+             (unsigned long long) (stats->ActiveNanos / 1000000), (unsigned long long) (stats->IdleNanos / 1000000));
+    LogStatsLine(useSyslog, line);
+
+    for(unsigned int i = 0; i < TOTAL_STATS; i++) {
+        Histogram copy;
+        LoadHistogram(&copy, &stats->Histograms[i]);
+        const Histogram *histogram = &copy;
+        int length = snprintf(line, sizeof(line), "%s: { Count: %llu, P50: %lluns, P99: %lluns, Max: %lluns, Buckets: {",
+                              GetStatString((Stat) i), (unsigned long long) histogram->Count,
+                              (unsigned long long) Percentile(histogram, 50), (unsigned long long) Percentile(histogram, 99),
+                              (unsigned long long) histogram->Max);
+
+        // Each bucket is labelled with its upper bound.
+        const char *separator = " ";
+        for(unsigned int bucket = 0; bucket < STATS_BUCKETS && length < (int) sizeof(line); bucket++) {
+            if(histogram->Buckets[bucket] > 0) {
+                length += snprintf(line + length, sizeof(line) - length, "%s<%lluns: %llu", separator,
+                                   1ULL << (bucket + 1), (unsigned long long) histogram->Buckets[bucket]);
+                separator = ", ";
+            }
+        }
+
+        if(length < (int) sizeof(line)) {
+            snprintf(line + length, sizeof(line) - length, " } }");
+        }
+        LogStatsLine(useSyslog, line);
+    }
+}
+
+// Some histograms are recorded on the emitter thread while they're logged, see RecordSharedStat.
+static void LoadHistogram(Histogram *const to, const Histogram *const from) {
+    to->Count = __atomic_load_n(&from->Count, __ATOMIC_RELAXED);
+    to->Max = __atomic_load_n(&from->Max, __ATOMIC_RELAXED);
+    for(unsigned int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+        to->Buckets[bucket] = __atomic_load_n(&from->Buckets[bucket], __ATOMIC_RELAXED);
+    }
+}
+
+static uint64_t Percentile(const Histogram *const histogram, unsigned int percent) {
+    if(histogram->Count == 0) {
+        return 0;
+    }
+
+    // Upper bound of the bucket the percentile falls in, but never more than we've actually seen.
+    const uint64_t target = (histogram->Count * percent + 99) / 100;
+    uint64_t total = 0;
+    for(unsigned int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+        total += histogram->Buckets[bucket];
+        if(total >= target) {
+            const uint64_t bound = 1ULL << (bucket + 1);
+            return bound < histogram->Max ? bound : histogram->Max;
+        }
+    }
+
+    return histogram->Max;
+}
+
+void LogStatsLine(bool useSyslog, const char *line) {
+    if(useSyslog) {
+        syslog(LOG_INFO, "%s", line);
+    } else {
+        fprintf(stderr, "%s\n", line);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "enum.h"
+
+// Bucket i counts durations in [2^i, 2^(i+1)) ns, the last bucket catches everything longer.
+#define STATS_BUCKETS 32
+
+#define ENUM_STAT(XX) \
+    XX(STAT_READ, =0, Read) \
+    XX(STAT_DECODE, =1, Decode) \
+    XX(STAT_EMIT, =2, Emit) \
+    XX(STAT_FRAME, =3, Frame) \
+    XX(STAT_LATENESS, =4, Lateness) \
+    XX(STAT_BUTTON_LATENCY, =5, ButtonLatency) \
+    XX(STAT_SYNC_ERROR, =6, SyncError)
+
+DECLARE_ENUM(Stat, ENUM_STAT)
+
+#define TOTAL_STATS (STAT_SYNC_ERROR + 1)
+
+typedef struct {
+    uint64_t Count;
+    uint64_t Max;
+    uint64_t Buckets[STATS_BUCKETS];
+} Histogram;
+
+typedef struct {
+    Histogram Histograms[TOTAL_STATS];
+    uint64_t Frames;
+    uint64_t Missed;
+    uint64_t Overruns; // Gamepad states that didn't fit in the emitter's ring
+    uint64_t ActiveNanos; // Time spent polling at the gamepad PollFrequency
+    uint64_t IdleNanos; // Time spent polling at the gamepad IdleFrequency
+} Stats;
+
+void ResetStats(Stats *stats);
+void LogStats(const Stats *stats, bool useSyslog);
+void LogStatsLine(bool useSyslog, const char *line);
+
+static inline unsigned int GetStatBucket(uint64_t nanos) {
+    unsigned int bucket = nanos == 0 ? 0 : 63 - (unsigned int) __builtin_clzll(nanos);
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+static inline void RecordStat(Stats *const stats, Stat stat, uint64_t nanos) {
+    Histogram *histogram = &stats->Histograms[stat];
+    histogram->Buckets[GetStatBucket(nanos)]++;
+    histogram->Count++;
+    if(nanos > histogram->Max) {
+        histogram->Max = nanos;
+    }
+}
+
+// For a stat recorded from another thread than the one that logs them, LogStats reads every histogram atomically.
+static inline void RecordSharedStat(Stats *const stats, Stat stat, uint64_t nanos) {
+    Histogram *histogram = &stats->Histograms[stat];
+    __atomic_fetch_add(&histogram->Buckets[GetStatBucket(nanos)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->Count, 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->Max, __ATOMIC_RELAXED);
+    while(nanos > max && !__atomic_compare_exchange_n(&histogram->Max, &max, nanos, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,84 @@
+/*
+ * SNESDev - User-space driver for the RetroPie GPIO Adapter for the Raspberry Pi.
+ *
+ * (c) Copyright 2012-2013  Florian Müller (contact@petrockblock.com)
+ *
+ * SNESDev homepage: https://github.com/petrockblog/SNESDev-RPi
+ *
+ * Permission to use, copy, modify and distribute SNESDev in both binary and
+ * source form, for non-commercial purposes, is hereby granted without fee,
+ * providing that this license information and copyright notice appear with
+ * all copies and any derived work.
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event shall the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * SNESDev is freeware for PERSONAL USE only. Commercial users should
+ * seek permission of the copyright holders first. Commercial use includes
+ * charging money for SNESDev or software derived from SNESDev.
+ *
+ * The copyright holders request that bug fixes and improvements to the code
+ * should be forwarded to them so everyone can benefit from the modifications
+ * in future versions.
+ *
+ * Raspberry Pi is a trademark of the Raspberry Pi Foundation.
+ */
+
+#include <time.h>
+
+#include "timing.h"
+
+#define CALIBRATION_LOOPS 1000000
+#define CALIBRATION_RUNS 5
+#define CALIBRATION_WARMUP_NANOS 50000000ULL
+
+// Loops per nanosecond as 16.16 fixed point.
+static uint64_t loopsPerNanosQ16;
+
+static uint64_t RawNanos(void);
+
+static inline void Spin(uint64_t loops) {
+    for(; loops > 0; loops--) {
+        __asm__ __volatile__("");
+    }
+}
+
+void CalibrateTiming(void) {
+    // Keep busy for a while first, so a cpufreq governor has ramped the clock up before we measure it.
+    const uint64_t warm = RawNanos() + CALIBRATION_WARMUP_NANOS;
+    while(RawNanos() < warm) {
+        Spin(1000);
+    }
+
+    // The fastest run is the one least disturbed by anything else on the cpu.
+    uint64_t fastest = UINT64_MAX;
+    for(unsigned int run = 0; run < CALIBRATION_RUNS; run++) {
+        const uint64_t start = RawNanos();
+        Spin(CALIBRATION_LOOPS);
+        const uint64_t elapsed = RawNanos() - start;
+        if(elapsed < fastest) {
+            fastest = elapsed;
+        }
+    }
+
+    loopsPerNanosQ16 = ((uint64_t) CALIBRATION_LOOPS << 16) / (fastest > 0 ? fastest : 1);
+}
+
+uint64_t TimingLoopsPerMicrosecond(void) {
+    return (loopsPerNanosQ16 * 1000) >> 16;
+}
+
+void SpinNanos(uint32_t nanos) {
+    if(__builtin_expect(loopsPerNanosQ16 == 0, 0)) {
+        CalibrateTiming();
+    }
+
+    Spin((nanos * loopsPerNanosQ16) >> 16);
+}
+
+static uint64_t RawNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
@@ -28,128 +28,217 @@
 #include <linux/input.h>
 #include <linux/uinput.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "realtime.h"
 #include "uinput.h"
 
 
 #define UINPUT_DEVICE "/dev/uinput"
 
 DEFINE_ENUM(InputKey, ENUM_INPUT_KEYS, unsigned int)
+DEFINE_ENUM(InputButton, ENUM_INPUT_BUTTONS, unsigned int)
+DEFINE_ENUM(InputAxis, ENUM_INPUT_AXES, unsigned int)
+
+typedef struct {
+    InputDevice *Device;
+    const InputCodes *Codes;
+    pthread_t Thread;
+    bool Started;
+    bool Success;
+} InputDeviceOpening;
+
+static bool WriteQueue(InputDevice *device);
+static void *RunOpenInputDevice(void *argument);
+
+void AddInputCode(InputCodes *const codes, unsigned short int type, unsigned short int code) {
+    switch (type) {
+        case EV_KEY:
+            codes->Keys[code / 64] |= 1ull << (code % 64);
+            break;
+        case EV_ABS:
+            codes->Axes[code / 64] |= 1ull << (code % 64);
+            break;
+    }
+}
+
+bool HasInputCodes(const InputCodes *const codes) {
+    for (unsigned int i = 0; i < KEY_CNT / 64; i++) {
+        if (codes->Keys[i] != 0) {
+            return true;
+        }
+    }
 
-bool OpenInputDevice(const InputDeviceType deviceType, InputDevice *const device)
+    for (unsigned int i = 0; i < ABS_CNT / 64; i++) {
+        if (codes->Axes[i] != 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool OpenInputDevice(InputDevice *const device, const InputCodes *const codes)
 {
-    device->File = open(UINPUT_DEVICE, O_WRONLY | O_NDELAY);
+    device->Queued = 0;
+    device->File = open(UINPUT_DEVICE, O_WRONLY | O_NDELAY | O_CLOEXEC);
     if (device->File < 0) {
         fprintf(stderr, "Unable to open %s\n", UINPUT_DEVICE);
         return false;
     }
 
-    struct uinput_user_dev userInput;
-    memset(&userInput, 0, sizeof(userInput));
-    strncpy(userInput.name, device->Name, strlen(device->Name));
-    userInput.id.version = 4;
-    userInput.id.bustype = BUS_USB;
-    userInput.id.product = 1;
-    userInput.id.vendor = 1;
-
-    // Setup the uinput device as a keyboard with basic keys
-    ioctl(device->File, UI_SET_EVBIT, EV_KEY);
-    ioctl(device->File, UI_SET_EVBIT, EV_REL);
-
-    switch (deviceType) {
-        case INPUT_GAMEPAD:
-            // Buttons.
-            ioctl(device->File, UI_SET_KEYBIT, BTN_A);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_B);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_X);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_Y);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_TL);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_TR);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_SELECT);
-            ioctl(device->File, UI_SET_KEYBIT, BTN_START);
-            // Axis.
-            ioctl(device->File, UI_SET_EVBIT, EV_ABS);
-            ioctl(device->File, UI_SET_ABSBIT, ABS_X);
-            ioctl(device->File, UI_SET_ABSBIT, ABS_Y);
-            userInput.absmin[ABS_X] = 0;
-            userInput.absmax[ABS_X] = 4;
-            userInput.absmin[ABS_Y] = 0;
-            userInput.absmax[ABS_Y] = 4;
-            break;
-        case INPUT_KEYBOARD:
-            for (unsigned int i = 0; i < 256; i++) {
-                ioctl(device->File, UI_SET_KEYBIT, i);
-            }
-            break;
+    // Only what's mapped is registered, so consumers see exactly the keys and axes that can be sent.
+    bool anyKeys = false, anyAxes = false;
+    for (unsigned int word = 0; word < KEY_CNT / 64; word++) {
+        anyKeys = anyKeys || codes->Keys[word] != 0;
+    }
+    for (unsigned int word = 0; word < ABS_CNT / 64; word++) {
+        anyAxes = anyAxes || codes->Axes[word] != 0;
     }
 
-    // Add input device into input sub-system
-    write(device->File, &userInput, sizeof(userInput));
-    if (ioctl(device->File, UI_DEV_CREATE) < 0) {
-        return false;
+    bool success = (!anyKeys || ioctl(device->File, UI_SET_EVBIT, EV_KEY) == 0)
+                   && (!anyAxes || ioctl(device->File, UI_SET_EVBIT, EV_ABS) == 0);
+    for (unsigned int word = 0; word < KEY_CNT / 64; word++) {
+        for (uint64_t bits = codes->Keys[word]; bits != 0; bits &= bits - 1) {
+            success = success && ioctl(device->File, UI_SET_KEYBIT, word * 64 + __builtin_ctzll(bits)) == 0;
+        }
     }
 
-    if(deviceType == INPUT_GAMEPAD){
-        WriteAxis(device, ABS_X, DIGITAL_AXIS_ORIGIN);
-        WriteAxis(device, ABS_Y, DIGITAL_AXIS_ORIGIN);
-        WriteSync(device);
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    strncpy(setup.name, device->Name, sizeof(setup.name) - 1);
+    setup.id.version = 4;
+    setup.id.bustype = BUS_USB;
+    setup.id.product = 1;
+    setup.id.vendor = 1;
+    success = success && ioctl(device->File, UI_DEV_SETUP, &setup) == 0;
+
+    // Axes start centred, so there's nothing to send once the device is created.
+    for (unsigned int word = 0; word < ABS_CNT / 64; word++) {
+        for (uint64_t bits = codes->Axes[word]; bits != 0; bits &= bits - 1) {
+            struct uinput_abs_setup axis;
+            memset(&axis, 0, sizeof(axis));
+            axis.code = (uint16_t) (word * 64 + __builtin_ctzll(bits));
+            axis.absinfo.minimum = DIGITAL_AXIS_HIGH;
+            axis.absinfo.maximum = DIGITAL_AXIS_LOW;
+            axis.absinfo.value = DIGITAL_AXIS_ORIGIN;
+            success = success
+                      && ioctl(device->File, UI_SET_ABSBIT, axis.code) == 0
+                      && ioctl(device->File, UI_ABS_SETUP, &axis) == 0;
+        }
+    }
+
+    if (!success || ioctl(device->File, UI_DEV_CREATE) < 0) {
+        fprintf(stderr, "Unable to create input device '%s'\n", device->Name);
+        close(device->File);
+        device->File = -1;
+        return false;
     }
 
     return true;
 }
 
+unsigned int OpenInputDevices(InputDevice *const *const devices, const InputCodes *const *const codes, unsigned int total) {
+    if (total == 0) {
+        return 0;
+    }
+
+    // Creating a device is mostly a wait on the kernel and udev, so they're all created at once.
+    // The first is done here, as is any that can't get a thread.
+    InputDeviceOpening openings[total];
+    for (unsigned int i = 0; i < total; i++) {
+        openings[i].Device = devices[i];
+        openings[i].Codes = codes[i];
+        openings[i].Started = i > 0 && StartThread(&openings[i].Thread, THREAD_PRIORITY_INHERIT, RunOpenInputDevice, &openings[i]) == 0;
+    }
+
+    unsigned int opened = 0;
+    for (unsigned int i = 0; i < total; i++) {
+        if (openings[i].Started) {
+            pthread_join(openings[i].Thread, NULL);
+        } else {
+            RunOpenInputDevice(&openings[i]);
+        }
+        opened += openings[i].Success ? 1 : 0;
+    }
+
+    return opened;
+}
+
 bool CloseInputDevice(InputDevice *const device)
 {
+    if (device->File < 0) {
+        return true;
+    }
+
     ioctl(device->File, UI_DEV_DESTROY);
-    return close(device->File) == 0;
+    bool success = close(device->File) == 0;
+    device->File = -1;
+    device->Queued = 0;
+    return success;
 }
 
-bool WriteAxis(InputDevice *const device, unsigned short int axis, DigitalAxisValue value) {
-    struct input_event event;
-    memset(&event, 0, sizeof(event));
+bool QueueAxis(InputDevice *const device, unsigned short int axis, DigitalAxisValue value) {
+    return QueueEvent(device, EV_ABS, axis, value);
+}
 
-    event.type = EV_ABS;
-    event.code = axis;
-    event.value = value;
+bool QueueKey(InputDevice *const device, unsigned short int key, bool keyPressed) {
+    return QueueEvent(device, EV_KEY, key, keyPressed);
+}
 
-    if (write(device->File, &event, sizeof(event)) <= 0) {
-        fprintf(stderr, "Unable to write axis to '%s'\n", device->Name);
-        return false;
+bool FlushInputDevice(InputDevice *const device) {
+    if(device->Queued == 0) {
+        return true;
     }
 
-    return true;
-}
-
-bool WriteKey(InputDevice *const device, unsigned short int key, bool keyPressed) {
-    struct input_event event;
-    memset(&event, 0, sizeof(event));
+    // Always room for the sync, see QueueEvent.
+    struct input_event *event = &device->Queue[device->Queued++];
+    memset(event, 0, sizeof(*event));
+    event->type = EV_SYN;
+    event->code = SYN_REPORT;
+    event->value = 0;
 
-    event.type = EV_KEY;
-    event.code = key;
-    event.value = keyPressed;
+    return WriteQueue(device);
+}
 
-    if (write(device->File, &event, sizeof(event)) <= 0) {
-        fprintf(stderr, "Unable to write key to '%s'\n", device->Name);
-        return false;
+bool QueueEvent(InputDevice *const device, unsigned short int type, unsigned short int code, int value) {
+    // Leave room for the sync. If the queue is full then write what we have, the sync still comes at the end.
+    bool success = true;
+    if(device->Queued == INPUT_QUEUE_SIZE - 1) {
+        success = WriteQueue(device);
     }
 
-    return true;
+    struct input_event *event = &device->Queue[device->Queued++];
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    event->code = code;
+    event->value = value;
+
+    return success;
 }
 
-bool WriteSync(InputDevice *const device) {
-    struct input_event event;
-    memset(&event, 0, sizeof(event));
+static bool WriteQueue(InputDevice *const device) {
+    const size_t size = device->Queued * sizeof(struct input_event);
+    device->Queued = 0;
 
-    event.type = EV_SYN;
-    event.code = SYN_REPORT;
-    event.value = 0;
+    // Nothing to write to, e.g. the device couldn't be created.
+    if (device->File < 0) {
+        return false;
+    }
 
-    if (write(device->File, &event, sizeof(event)) <= 0) {
-        fprintf(stderr, "Unable to write sync to '%s'\n", device->Name);
+    if (write(device->File, device->Queue, size) != (ssize_t) size) {
+        fprintf(stderr, "Unable to write events to '%s'\n", device->Name);
         return false;
     }
+
     return true;
 }
+
+static void *RunOpenInputDevice(void *argument) {
+    InputDeviceOpening *opening = argument;
+    opening->Success = OpenInputDevice(opening->Device, opening->Codes);
+    return NULL;
+}
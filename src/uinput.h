@@ -87,7 +87,45 @@
     XX(INPUT_KEY_F12, =88, F12)
 
 
+// Gamepad buttons and axes a gamepad button can be mapped to, by their names less the BTN_ and ABS_.
+#define ENUM_INPUT_BUTTONS(XX) \
+    XX(INPUT_BUTTON_A, =BTN_A, A) \
+    XX(INPUT_BUTTON_B, =BTN_B, B) \
+    XX(INPUT_BUTTON_C, =BTN_C, C) \
+    XX(INPUT_BUTTON_X, =BTN_X, X) \
+    XX(INPUT_BUTTON_Y, =BTN_Y, Y) \
+    XX(INPUT_BUTTON_Z, =BTN_Z, Z) \
+    XX(INPUT_BUTTON_TL, =BTN_TL, TL) \
+    XX(INPUT_BUTTON_TR, =BTN_TR, TR) \
+    XX(INPUT_BUTTON_TL2, =BTN_TL2, TL2) \
+    XX(INPUT_BUTTON_TR2, =BTN_TR2, TR2) \
+    XX(INPUT_BUTTON_SELECT, =BTN_SELECT, SELECT) \
+    XX(INPUT_BUTTON_START, =BTN_START, START) \
+    XX(INPUT_BUTTON_MODE, =BTN_MODE, MODE) \
+    XX(INPUT_BUTTON_THUMBL, =BTN_THUMBL, THUMBL) \
+    XX(INPUT_BUTTON_THUMBR, =BTN_THUMBR, THUMBR) \
+    XX(INPUT_BUTTON_DPAD_UP, =BTN_DPAD_UP, DPAD_UP) \
+    XX(INPUT_BUTTON_DPAD_DOWN, =BTN_DPAD_DOWN, DPAD_DOWN) \
+    XX(INPUT_BUTTON_DPAD_LEFT, =BTN_DPAD_LEFT, DPAD_LEFT) \
+    XX(INPUT_BUTTON_DPAD_RIGHT, =BTN_DPAD_RIGHT, DPAD_RIGHT)
+
+// ABS_X is 0, so look these up through InputAxisValues rather than GetInputAxisValue.
+#define ENUM_INPUT_AXES(XX) \
+    XX(INPUT_AXIS_X, =ABS_X, X) \
+    XX(INPUT_AXIS_Y, =ABS_Y, Y) \
+    XX(INPUT_AXIS_Z, =ABS_Z, Z) \
+    XX(INPUT_AXIS_RX, =ABS_RX, RX) \
+    XX(INPUT_AXIS_RY, =ABS_RY, RY) \
+    XX(INPUT_AXIS_RZ, =ABS_RZ, RZ) \
+    XX(INPUT_AXIS_HAT0X, =ABS_HAT0X, HAT0X) \
+    XX(INPUT_AXIS_HAT0Y, =ABS_HAT0Y, HAT0Y)
+
 DECLARE_ENUM(InputKey, ENUM_INPUT_KEYS)
+DECLARE_ENUM(InputButton, ENUM_INPUT_BUTTONS)
+DECLARE_ENUM(InputAxis, ENUM_INPUT_AXES)
+
+extern const InputAxis InputAxisValues[];
+extern const unsigned int TotalInputAxiss;
 
 typedef enum {
     DIGITAL_AXIS_HIGH = 0,
@@ -100,13 +138,28 @@ typedef enum {
     INPUT_KEYBOARD
 } InputDeviceType;
 
+// The keys and axes a device can send, it's created with only these. Axes are all digital.
+typedef struct {
+    uint64_t Keys[KEY_CNT / 64];
+    uint64_t Axes[ABS_CNT / 64];
+} InputCodes;
+
+// Events are queued per device and written with a single write() on flush.
+#define INPUT_QUEUE_SIZE 32
+
 typedef struct {
     int File;
     char Name[20];
+    unsigned int Queued;
+    struct input_event Queue[INPUT_QUEUE_SIZE];
 } InputDevice;
 
-bool OpenInputDevice(const InputDeviceType deviceType, InputDevice *device);
+void AddInputCode(InputCodes *codes, unsigned short int type, unsigned short int code);
+bool HasInputCodes(const InputCodes *codes);
+bool OpenInputDevice(InputDevice *device, const InputCodes *codes);
+unsigned int OpenInputDevices(InputDevice *const *devices, const InputCodes *const *codes, unsigned int total);
 bool CloseInputDevice(InputDevice *device);
-bool WriteKey(InputDevice *device, unsigned short int key, bool keyPressed);
-bool WriteAxis(InputDevice *device, unsigned short int axis, DigitalAxisValue value);
-bool WriteSync(InputDevice *device);
+bool QueueEvent(InputDevice *device, unsigned short int type, unsigned short int code, int value);
+bool QueueKey(InputDevice *device, unsigned short int key, bool keyPressed);
+bool QueueAxis(InputDevice *device, unsigned short int axis, DigitalAxisValue value);
+bool FlushInputDevice(InputDevice *device);